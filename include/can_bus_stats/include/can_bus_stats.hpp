@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <span>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+namespace can_stats {
+
+// Per-ID counters. `can_id` uses the SocketCAN encoding, so extended IDs keep
+// CAN_EFF_FLAG and never collide with standard ones.
+struct IdStats {
+    uint32_t can_id = 0;
+    uint64_t frames = 0;
+    uint64_t first_seen_ns = 0;
+    uint64_t last_seen_ns = 0;
+    uint64_t min_period_ns = 0;
+    uint64_t max_period_ns = 0;
+    double mean_period_ns = 0.0;
+    double period_m2 = 0.0;
+    uint32_t dlc_counts[16] = {};
+
+    double frame_rate() const;      // frames per second, from the mean period
+    double jitter_ns() const;       // standard deviation of the period
+};
+
+// Totals accumulated between two take_window() calls.
+struct WindowTotals {
+    uint64_t duration_ns = 0;
+    uint64_t frames = 0;
+    uint64_t bus_bits = 0;
+    uint64_t link_bytes = 0;
+
+    WindowTotals& operator+=(const WindowTotals& other);
+
+    double frame_rate() const;
+    double bus_load(uint32_t bitrate) const;            // percent of the CAN bitrate
+    double link_utilization(uint32_t baudrate) const;   // percent of an 8N1 UART
+};
+
+// Online statistics for one stream of frames. record() is O(1) and takes an
+// uncontended lock, so it is meant to stay enabled in production; reports are
+// pulled on demand.
+class BusStatistics {
+public:
+    explicit BusStatistics(size_t id_capacity = 1024);
+
+    void record(uint32_t can_id, std::span<const uint8_t> data, uint64_t timestamp_ns,
+                size_t link_bytes = 0);
+
+    WindowTotals take_window(uint64_t now_ns);
+    std::vector<IdStats> id_table() const;
+    uint64_t untracked_frames() const;
+    void reset();
+
+    // Exact on-wire length of a classic data frame in bit times, including
+    // stuff bits, CRC, ACK, EOF and interframe space.
+    static uint32_t frame_bits(uint32_t can_id, std::span<const uint8_t> data);
+    static uint64_t now_ns();
+
+private:
+    static constexpr uint32_t kEmpty = 0xFFFFFFFF;
+
+    std::vector<IdStats> table_;
+    size_t mask_;
+    size_t used_ = 0;
+    uint64_t untracked_ = 0;
+
+    WindowTotals window_;
+    uint64_t window_start_ns_ = 0;
+
+    mutable std::mutex mutex_;
+
+    IdStats* lookup(uint32_t can_id);
+};
+
+std::string format_report(const std::string& title, const BusStatistics& stats,
+                          const WindowTotals& window, uint32_t bitrate, uint32_t baudrate);
+
+} // namespace can_stats
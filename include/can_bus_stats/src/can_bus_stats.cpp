@@ -0,0 +1,268 @@
+#include "can_bus_stats.hpp"
+
+#include <linux/can.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+namespace can_stats {
+
+namespace {
+
+// Feeds frame bits MSB-first through the CRC-15 register and the bit stuffer.
+struct BitStream {
+    uint32_t bits = 0;
+    uint16_t crc = 0;
+    int last = -1;
+    int run = 0;
+
+    void emit(int bit) {
+        ++bits;
+        if (bit == last) {
+            if (++run == 5) {
+                ++bits;           // stuff bit of opposite polarity
+                last = !bit;
+                run = 1;
+            }
+        } else {
+            last = bit;
+            run = 1;
+        }
+    }
+
+    void push(int bit) {
+        int feedback = bit ^ ((crc >> 14) & 1);
+        crc = static_cast<uint16_t>((crc << 1) & 0x7FFF);
+        if (feedback) crc ^= 0x4599;
+        emit(bit);
+    }
+
+    void push_field(uint32_t value, int width) {
+        for (int i = width - 1; i >= 0; --i) push((value >> i) & 1);
+    }
+};
+
+uint8_t len_to_dlc(size_t len) {
+    if (len <= 8) return static_cast<uint8_t>(len);
+    if (len <= 12) return 9;
+    if (len <= 16) return 10;
+    if (len <= 20) return 11;
+    if (len <= 24) return 12;
+    if (len <= 32) return 13;
+    if (len <= 48) return 14;
+    return 15;
+}
+
+size_t hash_id(uint32_t can_id) {
+    return static_cast<size_t>(can_id * 0x9E3779B1u);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// IdStats / WindowTotals
+// ---------------------------------------------------------------------------
+
+double IdStats::frame_rate() const {
+    return mean_period_ns > 0.0 ? 1e9 / mean_period_ns : 0.0;
+}
+
+double IdStats::jitter_ns() const {
+    return frames > 2 ? std::sqrt(period_m2 / static_cast<double>(frames - 2)) : 0.0;
+}
+
+WindowTotals& WindowTotals::operator+=(const WindowTotals& other) {
+    duration_ns = std::max(duration_ns, other.duration_ns);
+    frames += other.frames;
+    bus_bits += other.bus_bits;
+    link_bytes += other.link_bytes;
+    return *this;
+}
+
+double WindowTotals::frame_rate() const {
+    return duration_ns ? frames * 1e9 / static_cast<double>(duration_ns) : 0.0;
+}
+
+double WindowTotals::bus_load(uint32_t bitrate) const {
+    if (!duration_ns || !bitrate) return 0.0;
+    return 100.0 * bus_bits / (bitrate * (duration_ns / 1e9));
+}
+
+double WindowTotals::link_utilization(uint32_t baudrate) const {
+    if (!duration_ns || !baudrate) return 0.0;
+    // 8N1: start bit + 8 data bits + stop bit per byte.
+    return 100.0 * (link_bytes * 10) / (baudrate * (duration_ns / 1e9));
+}
+
+// ---------------------------------------------------------------------------
+// BusStatistics
+// ---------------------------------------------------------------------------
+
+BusStatistics::BusStatistics(size_t id_capacity) {
+    size_t cap = 16;
+    while (cap < id_capacity * 2) cap <<= 1;    // keep the load factor at or below 1/2
+    table_.resize(cap);
+    for (auto& entry : table_) entry.can_id = kEmpty;
+    mask_ = cap - 1;
+}
+
+uint64_t BusStatistics::now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+uint32_t BusStatistics::frame_bits(uint32_t can_id, std::span<const uint8_t> data) {
+    BitStream s;
+    bool rtr = can_id & CAN_RTR_FLAG;
+
+    s.push(0);                                  // SOF
+    if (can_id & CAN_EFF_FLAG) {
+        uint32_t id = can_id & CAN_EFF_MASK;
+        s.push_field(id >> 18, 11);             // base ID
+        s.push(1);                              // SRR
+        s.push(1);                              // IDE
+        s.push_field(id & 0x3FFFF, 18);         // ID extension
+        s.push(rtr);
+        s.push(0);                              // r1
+        s.push(0);                              // r0
+    } else {
+        s.push_field(can_id & CAN_SFF_MASK, 11);
+        s.push(rtr);
+        s.push(0);                              // IDE
+        s.push(0);                              // r0
+    }
+    s.push_field(len_to_dlc(data.size()), 4);
+    if (!rtr) {
+        for (uint8_t byte : data) s.push_field(byte, 8);
+    }
+
+    uint16_t crc = s.crc;
+    for (int i = 14; i >= 0; --i) s.emit((crc >> i) & 1);
+
+    // CRC delimiter, ACK slot + delimiter, EOF and interframe space carry no stuffing.
+    return s.bits + 1 + 2 + 7 + 3;
+}
+
+IdStats* BusStatistics::lookup(uint32_t can_id) {
+    for (size_t i = hash_id(can_id) & mask_;; i = (i + 1) & mask_) {
+        IdStats& entry = table_[i];
+        if (entry.can_id == can_id) return &entry;
+        if (entry.can_id == kEmpty) {
+            if ((used_ + 1) * 2 > table_.size()) return nullptr;
+            entry.can_id = can_id;
+            ++used_;
+            return &entry;
+        }
+    }
+}
+
+void BusStatistics::record(uint32_t can_id, std::span<const uint8_t> data,
+                           uint64_t timestamp_ns, size_t link_bytes) {
+    uint32_t bits = frame_bits(can_id, data);
+
+    std::lock_guard lock(mutex_);
+
+    if (window_start_ns_ == 0) window_start_ns_ = timestamp_ns;
+    ++window_.frames;
+    window_.bus_bits += bits;
+    window_.link_bytes += link_bytes;
+
+    IdStats* entry = lookup(can_id);
+    if (!entry) {
+        ++untracked_;
+        return;
+    }
+
+    if (entry->frames == 0) {
+        entry->first_seen_ns = timestamp_ns;
+    } else if (timestamp_ns >= entry->last_seen_ns) {
+        // Welford's running mean/variance of the inter-frame period.
+        uint64_t period = timestamp_ns - entry->last_seen_ns;
+        uint64_t n = entry->frames;     // number of periods including this one
+        double delta = period - entry->mean_period_ns;
+        entry->mean_period_ns += delta / static_cast<double>(n);
+        entry->period_m2 += delta * (period - entry->mean_period_ns);
+        if (n == 1 || period < entry->min_period_ns) entry->min_period_ns = period;
+        if (period > entry->max_period_ns) entry->max_period_ns = period;
+    }
+
+    entry->last_seen_ns = timestamp_ns;
+    ++entry->frames;
+    ++entry->dlc_counts[len_to_dlc(data.size())];
+}
+
+WindowTotals BusStatistics::take_window(uint64_t now_ns) {
+    std::lock_guard lock(mutex_);
+    WindowTotals out = window_;
+    out.duration_ns = window_start_ns_ && now_ns > window_start_ns_ ? now_ns - window_start_ns_ : 0;
+    window_ = {};
+    window_start_ns_ = now_ns;
+    return out;
+}
+
+std::vector<IdStats> BusStatistics::id_table() const {
+    std::lock_guard lock(mutex_);
+    std::vector<IdStats> out;
+    out.reserve(used_);
+    for (const auto& entry : table_) {
+        if (entry.can_id != kEmpty) out.push_back(entry);
+    }
+    std::sort(out.begin(), out.end(),
+              [](const IdStats& a, const IdStats& b) { return a.can_id < b.can_id; });
+    return out;
+}
+
+uint64_t BusStatistics::untracked_frames() const {
+    std::lock_guard lock(mutex_);
+    return untracked_;
+}
+
+void BusStatistics::reset() {
+    std::lock_guard lock(mutex_);
+    for (auto& entry : table_) entry = IdStats{kEmpty};
+    used_ = 0;
+    untracked_ = 0;
+    window_ = {};
+    window_start_ns_ = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Reporting
+// ---------------------------------------------------------------------------
+
+std::string format_report(const std::string& title, const BusStatistics& stats,
+                          const WindowTotals& window, uint32_t bitrate, uint32_t baudrate) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+        << "== " << title << " ==\n"
+        << "window " << window.duration_ns / 1e6 << " ms: "
+        << window.frames << " frames, " << window.frame_rate() << " fps, "
+        << "bus load " << window.bus_load(bitrate) << "% of " << bitrate << " bps, "
+        << "serial " << window.link_utilization(baudrate) << "% of " << baudrate << " baud\n";
+
+    uint64_t now = BusStatistics::now_ns();
+    for (const auto& id : stats.id_table()) {
+        bool ext = id.can_id & CAN_EFF_FLAG;
+        oss << "  ID=0x" << std::hex << std::uppercase << std::setfill('0')
+            << std::setw(ext ? 8 : 3) << (id.can_id & (ext ? CAN_EFF_MASK : CAN_SFF_MASK))
+            << std::dec << std::setfill(' ')
+            << " n=" << id.frames
+            << " rate=" << id.frame_rate() << "/s"
+            << " jitter=" << id.jitter_ns() / 1e3 << "us"
+            << " period=[" << id.min_period_ns / 1e3 << "," << id.max_period_ns / 1e3 << "]us"
+            << " age=" << (now - id.last_seen_ns) / 1e6 << "ms dlc:";
+        for (int dlc = 0; dlc < 16; ++dlc) {
+            if (id.dlc_counts[dlc]) oss << ' ' << dlc << 'x' << id.dlc_counts[dlc];
+        }
+        oss << '\n';
+    }
+    if (uint64_t untracked = stats.untracked_frames()) {
+        oss << "  (" << untracked << " frames from IDs beyond the table capacity)\n";
+    }
+    return oss.str();
+}
+
+} // namespace can_stats
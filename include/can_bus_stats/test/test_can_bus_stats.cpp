@@ -0,0 +1,97 @@
+#include "can_bus_stats.hpp"
+
+#include <gtest/gtest.h>
+#include <linux/can.h>
+#include <vector>
+
+using namespace can_stats;
+
+TEST(BusStatisticsTest, FrameBitsAllZeroStandardFrame) {
+    // 34 dominant bits (SOF..CRC, CRC of all zeros is zero) need 6 stuff bits,
+    // plus 13 fixed bits of delimiter/ACK/EOF/IFS.
+    EXPECT_EQ(BusStatistics::frame_bits(0x000, {}), 53u);
+}
+
+TEST(BusStatisticsTest, FrameBitsWithinClassicBounds) {
+    std::vector<uint8_t> data = {0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0};
+    uint32_t std_bits = BusStatistics::frame_bits(0x123, data);
+    EXPECT_GE(std_bits, 111u);
+    EXPECT_LE(std_bits, 135u);
+
+    uint32_t ext_bits = BusStatistics::frame_bits(0x18FEF100 | CAN_EFF_FLAG, data);
+    EXPECT_GE(ext_bits, 131u);
+    EXPECT_LE(ext_bits, 160u);
+}
+
+TEST(BusStatisticsTest, StuffingDependsOnPayload) {
+    std::vector<uint8_t> zeros(8, 0x00);
+    std::vector<uint8_t> alternating(8, 0x55);
+    EXPECT_GT(BusStatistics::frame_bits(0x100, zeros), BusStatistics::frame_bits(0x100, alternating));
+}
+
+TEST(BusStatisticsTest, TracksPeriodJitterAndDlc) {
+    BusStatistics stats;
+    std::vector<uint8_t> data(4, 0xAA);
+
+    uint64_t t = 1'000'000;
+    for (int i = 0; i < 11; ++i) {
+        stats.record(0x321, data, t);
+        t += (i % 2) ? 9'000'000 : 11'000'000;  // 10 ms +/- 1 ms
+    }
+
+    auto table = stats.id_table();
+    ASSERT_EQ(table.size(), 1u);
+    const IdStats& id = table[0];
+    EXPECT_EQ(id.can_id, 0x321u);
+    EXPECT_EQ(id.frames, 11u);
+    EXPECT_NEAR(id.mean_period_ns, 10'000'000.0, 1.0);
+    EXPECT_NEAR(id.frame_rate(), 100.0, 0.01);
+    EXPECT_NEAR(id.jitter_ns(), 1'000'000.0, 60'000.0);
+    EXPECT_EQ(id.min_period_ns, 9'000'000u);
+    EXPECT_EQ(id.max_period_ns, 11'000'000u);
+    EXPECT_EQ(id.dlc_counts[4], 11u);
+}
+
+TEST(BusStatisticsTest, StandardAndExtendedIdsAreDistinct) {
+    BusStatistics stats;
+    stats.record(0x100, {}, 1);
+    stats.record(0x100 | CAN_EFF_FLAG, {}, 2);
+    EXPECT_EQ(stats.id_table().size(), 2u);
+}
+
+TEST(BusStatisticsTest, WindowComputesBusLoadAndLinkUtilization) {
+    BusStatistics stats;
+    std::vector<uint8_t> data(8, 0x55);
+    uint32_t bits = BusStatistics::frame_bits(0x200, data);
+
+    // 1000 frames in one second on a 1 Mbit/s bus, 13 serial bytes each.
+    for (int i = 0; i < 1000; ++i) {
+        stats.record(0x200, data, 1'000'000'000ull + i * 1'000'000ull, 13);
+    }
+    WindowTotals window = stats.take_window(2'000'000'000ull);
+
+    EXPECT_EQ(window.frames, 1000u);
+    EXPECT_EQ(window.duration_ns, 1'000'000'000u);
+    EXPECT_NEAR(window.frame_rate(), 1000.0, 1e-6);
+    EXPECT_NEAR(window.bus_load(1'000'000), bits * 1000 / 1e4, 1e-6);
+    EXPECT_NEAR(window.link_utilization(2'000'000), 13.0 * 10 * 1000 / 2e4, 1e-6);
+
+    WindowTotals empty = stats.take_window(3'000'000'000ull);
+    EXPECT_EQ(empty.frames, 0u);
+}
+
+TEST(BusStatisticsTest, TableOverflowIsCounted) {
+    BusStatistics stats(8);
+    for (uint32_t id = 0; id < 100; ++id) stats.record(id, {}, id + 1);
+    EXPECT_LE(stats.id_table().size(), 16u);
+    EXPECT_EQ(stats.id_table().size() + stats.untracked_frames(), 100u);
+}
+
+TEST(BusStatisticsTest, ReportMentionsEveryId) {
+    BusStatistics stats;
+    stats.record(0x7DF, {}, 10);
+    stats.record(0x18DAF110 | CAN_EFF_FLAG, {}, 20);
+    auto report = format_report("test", stats, stats.take_window(30), 500000, 2000000);
+    EXPECT_NE(report.find("ID=0x7DF"), std::string::npos);
+    EXPECT_NE(report.find("ID=0x18DAF110"), std::string::npos);
+}
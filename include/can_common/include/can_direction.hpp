@@ -0,0 +1,14 @@
+// can_direction.hpp — which way a frame is travelling through the bridge
+#pragma once
+
+#include <cstdint>
+
+namespace can_common {
+
+// Shared by the frame ring (where it is stored in shared memory), the rules
+// engine and the trace probes, so the values must stay as they are.
+enum class Direction : uint8_t {
+    UsbToHost = 0x00, HostToUsb
+};
+
+} // namespace can_common
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <array>
+#include <span>
+#include <optional>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace can_fd_pack {
+
+// Carries CAN FD payloads (up to 64 bytes) over a classic 8-byte link by
+// splitting them across consecutive classic frames with the same ID. Byte 0
+// of every fragment is a header:
+//
+//   bit 7    START   first fragment of a payload
+//   bit 6    END     last fragment of a payload
+//   bits 5-4 counter message counter, the same in every fragment of a payload
+//   bits 3-0 index   fragment number, 0 for START
+//
+// A payload of up to 7 bytes fits one START|END fragment; its length is the
+// DLC minus one. Longer payloads put their total length in byte 1 of the
+// START fragment followed by 6 data bytes; every later fragment carries 7.
+// A 64-byte payload therefore takes 10 classic frames.
+constexpr size_t kMaxPayload = 64;
+constexpr size_t kClassicPayload = 8;
+constexpr size_t kMaxFragments = 10;
+
+constexpr uint8_t kStartBit = 0x80;
+constexpr uint8_t kEndBit = 0x40;
+
+struct Fragment {
+    uint32_t can_id;
+    uint8_t len;
+    std::array<uint8_t, kClassicPayload> data;
+
+    std::span<const uint8_t> payload() const { return {data.data(), len}; }
+};
+
+// Number of classic frames a payload of `len` bytes is split into.
+constexpr size_t fragment_count(size_t len) {
+    if (len <= 7) return 1;
+    return 1 + (len - 6 + 7 - 1) / 7;   // START carries 6 bytes, the rest 7 each
+}
+
+// Which frames are packed: those with (can_id & mask) == value, SocketCAN
+// encoding. Remote frames are never packed.
+struct PackingFilter {
+    uint32_t value = 0;
+    uint32_t mask = 0;
+
+    bool matches(uint32_t can_id) const;
+};
+
+// `all`, `<id>` or `<value>/<mask>`; extended IDs need CAN_EFF_FLAG (0x80000000) set.
+std::optional<PackingFilter> parse_filter(std::string_view text);
+
+struct PackingCounters {
+    uint64_t payloads_packed = 0;
+    uint64_t fragments_sent = 0;
+    uint64_t payloads_reassembled = 0;
+    uint64_t fragments_received = 0;
+    uint64_t sequence_errors = 0;     // out-of-order, foreign-counter or orphan fragments
+    uint64_t timeouts = 0;            // partial payloads abandoned as stale
+    uint64_t evictions = 0;           // partial payloads pushed out by a full slot table
+    uint64_t malformed = 0;           // empty fragments or impossible lengths
+};
+
+class Packer {
+public:
+    // Splits `data` into fragments. Returns how many were written to `out`,
+    // or 0 if `data` is longer than kMaxPayload.
+    size_t pack(uint32_t can_id, std::span<const uint8_t> data,
+                std::array<Fragment, kMaxFragments>& out);
+
+    PackingCounters counters() const;
+
+private:
+    uint8_t counter_ = 0;
+    std::atomic<uint64_t> payloads_packed_ = 0;
+    std::atomic<uint64_t> fragments_sent_ = 0;
+};
+
+// Reassembles fragments into payloads using a fixed table of slots, one per
+// ID with a payload in flight, allocated up front. When every slot is busy
+// the one idle longest is reused.
+class Reassembler {
+public:
+    explicit Reassembler(size_t slots = 64, uint64_t timeout_ns = 100'000'000);
+
+    // Feeds one classic frame. When it completes a payload, returns a view of
+    // it that stays valid until the next push().
+    std::optional<std::span<uint8_t>> push(uint32_t can_id, std::span<const uint8_t> fragment,
+                                           uint64_t now_ns);
+
+    size_t in_flight() const;
+    // Safe to call from another thread; the values are a snapshot.
+    PackingCounters counters() const;
+
+private:
+    // Slot keys live in their own array so a lookup scans a few cache lines.
+    static constexpr uint32_t kFree = 0xFFFFFFFF;
+
+    struct Slot {
+        uint8_t counter = 0;
+        uint8_t next_index = 0;
+        uint8_t total = 0;
+        uint8_t received = 0;
+        uint64_t updated_ns = 0;
+        std::array<uint8_t, kMaxPayload> data{};
+    };
+
+    std::vector<uint32_t> ids_;
+    std::vector<Slot> slots_;
+    std::array<uint8_t, kClassicPayload> single_{};
+    uint64_t timeout_ns_;
+
+    std::atomic<uint64_t> payloads_reassembled_ = 0;
+    std::atomic<uint64_t> fragments_received_ = 0;
+    std::atomic<uint64_t> sequence_errors_ = 0;
+    std::atomic<uint64_t> timeouts_ = 0;
+    std::atomic<uint64_t> evictions_ = 0;
+    std::atomic<uint64_t> malformed_ = 0;
+
+    size_t find(uint32_t can_id, uint64_t now_ns);
+    size_t claim(uint32_t can_id);
+    void release(size_t index);
+};
+
+} // namespace can_fd_pack
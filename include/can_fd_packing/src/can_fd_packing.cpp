@@ -0,0 +1,220 @@
+#include "can_fd_packing.hpp"
+
+#include <linux/can.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace can_fd_pack {
+
+namespace {
+
+bool parse_number(std::string_view text, uint32_t& out) {
+    if (text.empty()) return false;
+    try {
+        size_t used = 0;
+        unsigned long value = std::stoul(std::string(text), &used, 0);
+        if (used != text.size() || value > 0xFFFFFFFFul) return false;
+        out = static_cast<uint32_t>(value);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+} // namespace
+
+bool PackingFilter::matches(uint32_t can_id) const {
+    return !(can_id & CAN_RTR_FLAG) && (can_id & mask) == value;
+}
+
+std::optional<PackingFilter> parse_filter(std::string_view text) {
+    if (text == "all") return PackingFilter{0, 0};
+
+    PackingFilter filter;
+    size_t slash = text.find('/');
+    if (slash == std::string_view::npos) {
+        if (!parse_number(text, filter.value)) return std::nullopt;
+        filter.mask = (filter.value & CAN_EFF_FLAG) ? CAN_EFF_FLAG | CAN_EFF_MASK : CAN_EFF_FLAG | CAN_SFF_MASK;
+    } else {
+        if (!parse_number(text.substr(0, slash), filter.value) ||
+            !parse_number(text.substr(slash + 1), filter.mask))
+            return std::nullopt;
+    }
+    filter.value &= filter.mask;
+    return filter;
+}
+
+size_t Packer::pack(uint32_t can_id, std::span<const uint8_t> data,
+                    std::array<Fragment, kMaxFragments>& out) {
+    if (data.size() > kMaxPayload) return 0;
+
+    const uint8_t counter = static_cast<uint8_t>((counter_++ & 0x03) << 4);
+    const size_t count = fragment_count(data.size());
+
+    if (count == 1) {
+        Fragment& f = out[0];
+        f.can_id = can_id;
+        f.len = static_cast<uint8_t>(1 + data.size());
+        f.data[0] = kStartBit | kEndBit | counter;
+        std::copy(data.begin(), data.end(), f.data.begin() + 1);
+    } else {
+        size_t off = 0;
+        for (size_t i = 0; i < count; ++i) {
+            Fragment& f = out[i];
+            f.can_id = can_id;
+            f.data[0] = counter | static_cast<uint8_t>(i);
+            size_t header = 1;
+            if (i == 0) {
+                f.data[0] |= kStartBit;
+                f.data[1] = static_cast<uint8_t>(data.size());
+                header = 2;
+            }
+            if (i == count - 1) f.data[0] |= kEndBit;
+
+            size_t chunk = std::min(kClassicPayload - header, data.size() - off);
+            std::copy_n(data.begin() + off, chunk, f.data.begin() + header);
+            f.len = static_cast<uint8_t>(header + chunk);
+            off += chunk;
+        }
+    }
+
+    ++payloads_packed_;
+    fragments_sent_ += count;
+    return count;
+}
+
+PackingCounters Packer::counters() const {
+    PackingCounters c;
+    c.payloads_packed = payloads_packed_;
+    c.fragments_sent = fragments_sent_;
+    return c;
+}
+
+Reassembler::Reassembler(size_t slots, uint64_t timeout_ns)
+    : ids_(std::max<size_t>(slots, 1), kFree), slots_(std::max<size_t>(slots, 1)), timeout_ns_(timeout_ns) {}
+
+PackingCounters Reassembler::counters() const {
+    PackingCounters c;
+    c.payloads_reassembled = payloads_reassembled_;
+    c.fragments_received = fragments_received_;
+    c.sequence_errors = sequence_errors_;
+    c.timeouts = timeouts_;
+    c.evictions = evictions_;
+    c.malformed = malformed_;
+    return c;
+}
+
+size_t Reassembler::in_flight() const {
+    return std::count_if(ids_.begin(), ids_.end(), [](uint32_t id) { return id != kFree; });
+}
+
+void Reassembler::release(size_t index) {
+    ids_[index] = kFree;
+}
+
+size_t Reassembler::find(uint32_t can_id, uint64_t now_ns) {
+    auto it = std::find(ids_.begin(), ids_.end(), can_id);
+    if (it == ids_.end()) return ids_.size();
+
+    size_t index = it - ids_.begin();
+    if (now_ns - slots_[index].updated_ns > timeout_ns_) {
+        ++timeouts_;
+        release(index);
+        return ids_.size();
+    }
+    return index;
+}
+
+size_t Reassembler::claim(uint32_t can_id) {
+    auto it = std::find(ids_.begin(), ids_.end(), kFree);
+    size_t index;
+    if (it != ids_.end()) {
+        index = it - ids_.begin();
+    } else {
+        auto oldest = std::min_element(slots_.begin(), slots_.end(), [](const Slot& a, const Slot& b) {
+            return a.updated_ns < b.updated_ns;
+        });
+        index = oldest - slots_.begin();
+        ++evictions_;
+    }
+    ids_[index] = can_id;
+    return index;
+}
+
+std::optional<std::span<uint8_t>> Reassembler::push(uint32_t can_id, std::span<const uint8_t> fragment,
+                                                    uint64_t now_ns) {
+    ++fragments_received_;
+    if (fragment.empty()) {
+        ++malformed_;
+        return std::nullopt;
+    }
+
+    const uint8_t header = fragment[0];
+    const uint8_t counter = header & 0x30;
+    const uint8_t index = header & 0x0F;
+    const bool start = header & kStartBit;
+    const bool end = header & kEndBit;
+
+    size_t at = find(can_id, now_ns);
+
+    if (start) {
+        if (at != ids_.size()) {
+            // The previous payload on this ID never finished.
+            ++sequence_errors_;
+            release(at);
+        }
+
+        if (end) {
+            // Single-fragment payload: nothing to keep in the table.
+            std::copy(fragment.begin() + 1, fragment.end(), single_.begin());
+            ++payloads_reassembled_;
+            return std::span<uint8_t>(single_.data(), fragment.size() - 1);
+        }
+
+        if (index != 0 || fragment.size() < 2 || fragment[1] <= kClassicPayload - 1 ||
+            fragment[1] > kMaxPayload || fragment.size() - 2 > fragment[1]) {
+            ++malformed_;
+            return std::nullopt;
+        }
+
+        Slot& slot = slots_[claim(can_id)];
+        slot.counter = counter;
+        slot.next_index = 1;
+        slot.total = fragment[1];
+        slot.received = static_cast<uint8_t>(fragment.size() - 2);
+        slot.updated_ns = now_ns;
+        std::copy(fragment.begin() + 2, fragment.end(), slot.data.begin());
+        return std::nullopt;
+    }
+
+    if (at == ids_.size()) {
+        ++sequence_errors_;        // its START was lost or timed out
+        return std::nullopt;
+    }
+
+    Slot& slot = slots_[at];
+    const size_t chunk = fragment.size() - 1;
+    if (counter != slot.counter || index != slot.next_index || slot.received + chunk > slot.total) {
+        ++sequence_errors_;
+        release(at);
+        return std::nullopt;
+    }
+
+    std::copy(fragment.begin() + 1, fragment.end(), slot.data.begin() + slot.received);
+    slot.received += chunk;
+    slot.next_index = (slot.next_index + 1) & 0x0F;
+    slot.updated_ns = now_ns;
+
+    if (!end) return std::nullopt;
+
+    release(at);
+    if (slot.received != slot.total) {
+        ++sequence_errors_;
+        return std::nullopt;
+    }
+    ++payloads_reassembled_;
+    return std::span<uint8_t>(slot.data.data(), slot.total);
+}
+
+} // namespace can_fd_pack
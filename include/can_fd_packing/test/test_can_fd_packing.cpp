@@ -0,0 +1,162 @@
+#include "can_fd_packing.hpp"
+
+#include <gtest/gtest.h>
+#include <linux/can.h>
+#include <vector>
+#include <numeric>
+
+using namespace can_fd_pack;
+
+namespace {
+
+std::vector<uint8_t> payload_of(size_t len, uint8_t seed = 0) {
+    std::vector<uint8_t> data(len);
+    std::iota(data.begin(), data.end(), seed);
+    return data;
+}
+
+} // namespace
+
+TEST(FdPackingTest, FragmentCounts) {
+    EXPECT_EQ(fragment_count(0), 1u);
+    EXPECT_EQ(fragment_count(7), 1u);
+    EXPECT_EQ(fragment_count(8), 2u);
+    EXPECT_EQ(fragment_count(13), 2u);
+    EXPECT_EQ(fragment_count(14), 3u);
+    EXPECT_EQ(fragment_count(64), kMaxFragments);
+}
+
+TEST(FdPackingTest, RoundTripsEveryLength) {
+    Packer packer;
+    Reassembler reassembler;
+    std::array<Fragment, kMaxFragments> fragments;
+
+    for (size_t len = 0; len <= kMaxPayload; ++len) {
+        auto data = payload_of(len, static_cast<uint8_t>(len));
+        size_t count = packer.pack(0x123, data, fragments);
+        ASSERT_EQ(count, fragment_count(len)) << "len " << len;
+
+        std::optional<std::span<uint8_t>> whole;
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_LE(fragments[i].len, kClassicPayload);
+            ASSERT_FALSE(whole.has_value());
+            whole = reassembler.push(fragments[i].can_id, fragments[i].payload(), 1000);
+        }
+        ASSERT_TRUE(whole.has_value()) << "len " << len;
+        EXPECT_TRUE(std::equal(whole->begin(), whole->end(), data.begin(), data.end())) << "len " << len;
+    }
+    EXPECT_EQ(reassembler.in_flight(), 0u);
+    EXPECT_EQ(reassembler.counters().sequence_errors, 0u);
+    EXPECT_EQ(packer.counters().fragments_sent, reassembler.counters().fragments_received);
+}
+
+TEST(FdPackingTest, InterleavedIdsReassembleIndependently) {
+    Packer packer;
+    Reassembler reassembler;
+    std::array<Fragment, kMaxFragments> a, b;
+    auto data_a = payload_of(64, 0x00);
+    auto data_b = payload_of(20, 0x80);
+    size_t na = packer.pack(0x100, data_a, a);
+    size_t nb = packer.pack(0x18DAF110 | CAN_EFF_FLAG, data_b, b);
+
+    int completed = 0;
+    for (size_t i = 0; i < std::max(na, nb); ++i) {
+        if (i < na) {
+            if (auto whole = reassembler.push(a[i].can_id, a[i].payload(), 10)) {
+                EXPECT_TRUE(std::equal(whole->begin(), whole->end(), data_a.begin(), data_a.end()));
+                ++completed;
+            }
+        }
+        if (i < nb) {
+            if (auto whole = reassembler.push(b[i].can_id, b[i].payload(), 10)) {
+                EXPECT_TRUE(std::equal(whole->begin(), whole->end(), data_b.begin(), data_b.end()));
+                ++completed;
+            }
+        }
+    }
+    EXPECT_EQ(completed, 2);
+}
+
+TEST(FdPackingTest, LostFragmentDropsPayloadAndRecovers) {
+    Packer packer;
+    Reassembler reassembler;
+    std::array<Fragment, kMaxFragments> fragments;
+
+    auto data = payload_of(30);
+    size_t count = packer.pack(0x200, data, fragments);
+    for (size_t i = 0; i < count; ++i) {
+        if (i == 2) continue;
+        EXPECT_FALSE(reassembler.push(0x200, fragments[i].payload(), 10).has_value());
+    }
+    EXPECT_GE(reassembler.counters().sequence_errors, 1u);
+    EXPECT_EQ(reassembler.in_flight(), 0u);
+
+    count = packer.pack(0x200, data, fragments);
+    std::optional<std::span<uint8_t>> whole;
+    for (size_t i = 0; i < count; ++i) whole = reassembler.push(0x200, fragments[i].payload(), 20);
+    ASSERT_TRUE(whole.has_value());
+    EXPECT_EQ(whole->size(), 30u);
+}
+
+TEST(FdPackingTest, CounterMismatchIsNotMerged) {
+    Packer packer;
+    Reassembler reassembler;
+    std::array<Fragment, kMaxFragments> first, second;
+    auto data = payload_of(20);
+    packer.pack(0x300, data, first);
+    packer.pack(0x300, data, second);
+
+    // First payload's head, then the second payload's tail with a matching index.
+    reassembler.push(0x300, first[0].payload(), 10);
+    reassembler.push(0x300, first[1].payload(), 10);
+    EXPECT_FALSE(reassembler.push(0x300, second[2].payload(), 10).has_value());
+    EXPECT_EQ(reassembler.counters().sequence_errors, 1u);
+}
+
+TEST(FdPackingTest, StalePartialPayloadTimesOut) {
+    Packer packer;
+    Reassembler reassembler(4, 1000);
+    std::array<Fragment, kMaxFragments> fragments;
+    size_t count = packer.pack(0x400, payload_of(20), fragments);
+
+    reassembler.push(0x400, fragments[0].payload(), 0);
+    EXPECT_EQ(reassembler.in_flight(), 1u);
+    for (size_t i = 1; i < count; ++i) reassembler.push(0x400, fragments[i].payload(), 5000);
+    EXPECT_EQ(reassembler.counters().timeouts, 1u);
+    EXPECT_EQ(reassembler.counters().payloads_reassembled, 0u);
+}
+
+TEST(FdPackingTest, FullTableEvictsOldestSlot) {
+    Packer packer;
+    Reassembler reassembler(2);
+    std::array<Fragment, kMaxFragments> fragments;
+
+    for (uint32_t id = 1; id <= 3; ++id) {
+        packer.pack(id, payload_of(20), fragments);
+        reassembler.push(id, fragments[0].payload(), id);
+    }
+    EXPECT_EQ(reassembler.in_flight(), 2u);
+    EXPECT_EQ(reassembler.counters().evictions, 1u);
+}
+
+TEST(FdPackingTest, ParsesFilters) {
+    auto all = parse_filter("all");
+    ASSERT_TRUE(all.has_value());
+    EXPECT_TRUE(all->matches(0x123));
+    EXPECT_TRUE(all->matches(0x1234 | CAN_EFF_FLAG));
+    EXPECT_FALSE(all->matches(0x123 | CAN_RTR_FLAG));
+
+    auto exact = parse_filter("0x123");
+    ASSERT_TRUE(exact.has_value());
+    EXPECT_TRUE(exact->matches(0x123));
+    EXPECT_FALSE(exact->matches(0x124));
+    EXPECT_FALSE(exact->matches(0x123 | CAN_EFF_FLAG));
+
+    auto range = parse_filter("0x98DA0000/0x9FFF0000");
+    ASSERT_TRUE(range.has_value());
+    EXPECT_TRUE(range->matches(0x18DAF110 | CAN_EFF_FLAG));
+    EXPECT_FALSE(range->matches(0x18DBF110 | CAN_EFF_FLAG));
+
+    EXPECT_FALSE(parse_filter("bogus").has_value());
+    EXPECT_FALSE(parse_filter("0x100/").has_value());
+}
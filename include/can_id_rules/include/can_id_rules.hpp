@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <span>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include "can_direction.hpp"
+
+namespace can_rules {
+
+using Direction = can_common::Direction;
+
+enum class Verdict {
+    Unmatched,
+    Rewritten,
+    Drop
+};
+
+enum class IdOpKind : uint8_t {
+    Set, Add, And, Or
+};
+
+enum class PayloadOpKind : uint8_t {
+    Swap16, Swap32, And, Or, Set
+};
+
+enum class Format : uint8_t {
+    Keep, Standard, Extended
+};
+
+struct IdOp {
+    IdOpKind kind;
+    uint32_t value;
+};
+
+struct PayloadOp {
+    PayloadOpKind kind;
+    uint8_t offset;
+    uint8_t value;
+};
+
+// A compiled rule: everything apply() needs, in fixed-size arrays.
+struct Rule {
+    static constexpr size_t kMaxIdOps = 4;
+    static constexpr size_t kMaxPayloadOps = 8;
+
+    bool drop = false;
+    Format format = Format::Keep;
+    uint8_t id_op_count = 0;
+    uint8_t payload_op_count = 0;
+    std::array<IdOp, kMaxIdOps> id_ops{};
+    std::array<PayloadOp, kMaxPayloadOps> payload_ops{};
+    size_t line = 0;
+};
+
+// ID remapping and payload rewrite rules, compiled from a config file into
+// O(1) lookups: a direct-index table for 11-bit IDs and, for 29-bit IDs, one
+// hash table per distinct match mask (exact IDs and ranges share the full mask).
+// When several rules match a frame, the one written first wins.
+//
+//   # direction  match                        actions...
+//   usb          std 0x100-0x17F              id+=0x400
+//   host         ext 0x18FEF100/0x1FFFFF00    id&=0x1FFFFF00 id|=0x21
+//   both         std 0x321                    id=0x18FF0021 ext swap16@2 and@0=0x7F
+//   usb          std 0x7DF                    drop
+//
+// Directions: `usb` (USB -> host), `host` (host -> USB), `both`.
+// Matches: `std|ext <id>`, `<lo>-<hi>`, or `<value>/<mask>`.
+// ID actions: `id=V`, `id+=V`, `id-=V`, `id&=V`, `id|=V`, then `std`/`ext` to
+// change the frame format. Payload actions: `swap16@N`, `swap32@N`,
+// `and@N=V`, `or@N=V`, `set@N=V`. `drop` discards the frame.
+class RuleSet {
+public:
+    RuleSet();
+
+    bool load(std::string_view text, std::string* error = nullptr);
+    bool load_file(const std::string& path, std::string* error = nullptr);
+    void clear();
+
+    // `can_id` uses the SocketCAN encoding (CAN_EFF_FLAG marks extended IDs).
+    const Rule* match(Direction direction, uint32_t can_id) const;
+    Verdict apply(Direction direction, uint32_t& can_id, std::span<uint8_t> data) const;
+
+    size_t size() const;
+    bool empty() const;
+
+private:
+    static constexpr uint16_t kNoRule = 0xFFFF;
+    static constexpr uint32_t kMaxExpandedRange = 65536;
+
+    struct MaskClass {
+        uint32_t mask;
+        std::unordered_map<uint32_t, uint16_t> rules;
+    };
+
+    struct Table {
+        std::array<uint16_t, 2048> standard;
+        std::vector<MaskClass> extended;
+    };
+
+    std::vector<Rule> rules_;
+    std::array<Table, 2> tables_;
+
+    static void apply_rule(const Rule& rule, uint32_t& can_id, std::span<uint8_t> data);
+    static void insert_extended(Table& table, uint32_t mask, uint32_t value, uint16_t index);
+};
+
+} // namespace can_rules
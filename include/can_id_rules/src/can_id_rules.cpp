@@ -0,0 +1,279 @@
+#include "can_id_rules.hpp"
+
+#include <linux/can.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <utility>
+
+namespace can_rules {
+
+namespace {
+
+bool parse_number(std::string_view text, uint32_t& out) {
+    int base = 10;
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        text.remove_prefix(2);
+        base = 16;
+    }
+    if (text.empty()) return false;
+
+    uint64_t value = 0;
+    for (char c : text) {
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (base == 16 && c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (base == 16 && c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return false;
+        value = value * base + digit;
+        if (value > 0xFFFFFFFFull) return false;
+    }
+    out = static_cast<uint32_t>(value);
+    return true;
+}
+
+std::vector<std::string_view> split_words(std::string_view line) {
+    std::vector<std::string_view> words;
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) ++i;
+        size_t start = i;
+        while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') ++i;
+        if (i > start) words.push_back(line.substr(start, i - start));
+    }
+    return words;
+}
+
+// Parses `<offset>` or `<offset>=<value>` following an `op@` prefix.
+bool parse_payload_args(std::string_view text, bool with_value, uint8_t& offset, uint8_t& value) {
+    uint32_t off = 0, val = 0;
+    size_t eq = text.find('=');
+    if (with_value != (eq != std::string_view::npos)) return false;
+    if (!parse_number(text.substr(0, eq), off) || off >= CANFD_MAX_DLEN) return false;
+    if (with_value && (!parse_number(text.substr(eq + 1), val) || val > 0xFF)) return false;
+    offset = static_cast<uint8_t>(off);
+    value = static_cast<uint8_t>(val);
+    return true;
+}
+
+bool parse_action(std::string_view word, Rule& rule) {
+    static const std::pair<std::string_view, IdOpKind> id_ops[] = {
+        {"id+=", IdOpKind::Add}, {"id-=", IdOpKind::Add}, {"id&=", IdOpKind::And},
+        {"id|=", IdOpKind::Or},  {"id=", IdOpKind::Set},
+    };
+    static const std::pair<std::string_view, PayloadOpKind> payload_ops[] = {
+        {"swap16@", PayloadOpKind::Swap16}, {"swap32@", PayloadOpKind::Swap32},
+        {"and@", PayloadOpKind::And}, {"or@", PayloadOpKind::Or}, {"set@", PayloadOpKind::Set},
+    };
+
+    if (word == "drop") { rule.drop = true; return true; }
+    if (word == "std")  { rule.format = Format::Standard; return true; }
+    if (word == "ext")  { rule.format = Format::Extended; return true; }
+
+    for (const auto& [prefix, kind] : id_ops) {
+        if (!word.starts_with(prefix)) continue;
+        uint32_t value;
+        if (!parse_number(word.substr(prefix.size()), value)) return false;
+        if (rule.id_op_count == Rule::kMaxIdOps) return false;
+        if (prefix == "id-=") value = 0u - value;
+        rule.id_ops[rule.id_op_count++] = {kind, value};
+        return true;
+    }
+
+    for (const auto& [prefix, kind] : payload_ops) {
+        if (!word.starts_with(prefix)) continue;
+        bool with_value = kind != PayloadOpKind::Swap16 && kind != PayloadOpKind::Swap32;
+        PayloadOp op{kind, 0, 0};
+        if (!parse_payload_args(word.substr(prefix.size()), with_value, op.offset, op.value)) return false;
+        if (rule.payload_op_count == Rule::kMaxPayloadOps) return false;
+        rule.payload_ops[rule.payload_op_count++] = op;
+        return true;
+    }
+
+    return false;
+}
+
+} // namespace
+
+void RuleSet::insert_extended(Table& table, uint32_t mask, uint32_t value, uint16_t index) {
+    auto it = std::find_if(table.extended.begin(), table.extended.end(),
+                           [mask](const MaskClass& c) { return c.mask == mask; });
+    if (it == table.extended.end()) {
+        table.extended.push_back({mask, {}});
+        it = table.extended.end() - 1;
+    }
+    it->rules.emplace(value & mask, index);     // earlier rules keep their slot
+}
+
+RuleSet::RuleSet() { clear(); }
+
+void RuleSet::clear() {
+    rules_.clear();
+    for (auto& table : tables_) {
+        table.standard.fill(kNoRule);
+        table.extended.clear();
+    }
+}
+
+bool RuleSet::load_file(const std::string& path, std::string* error) {
+    std::ifstream in(path);
+    if (!in) {
+        if (error) *error = "cannot open " + path;
+        return false;
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    return load(text.str(), error);
+}
+
+bool RuleSet::load(std::string_view text, std::string* error) {
+    RuleSet compiled;
+
+    auto fail = [error](size_t line, const std::string& msg) {
+        if (error) *error = "line " + std::to_string(line) + ": " + msg;
+        return false;
+    };
+
+    size_t line_no = 0;
+    while (!text.empty()) {
+        ++line_no;
+        size_t nl = text.find('\n');
+        std::string_view line = text.substr(0, nl);
+        text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+
+        if (size_t hash = line.find('#'); hash != std::string_view::npos) line = line.substr(0, hash);
+        auto words = split_words(line);
+        if (words.empty()) continue;
+        if (words.size() < 4) return fail(line_no, "expected <direction> <std|ext> <match> <action>...");
+
+        bool dirs[2] = {false, false};
+        if (words[0] == "usb") dirs[0] = true;
+        else if (words[0] == "host") dirs[1] = true;
+        else if (words[0] == "both") dirs[0] = dirs[1] = true;
+        else return fail(line_no, "unknown direction '" + std::string(words[0]) + "'");
+
+        bool extended;
+        if (words[1] == "std") extended = false;
+        else if (words[1] == "ext") extended = true;
+        else return fail(line_no, "expected std or ext, got '" + std::string(words[1]) + "'");
+        const uint32_t id_max = extended ? CAN_EFF_MASK : CAN_SFF_MASK;
+
+        // <id>, <lo>-<hi> or <value>/<mask>
+        uint32_t lo, hi, mask = id_max;
+        std::string_view match = words[2];
+        size_t dash = match.find('-'), slash = match.find('/');
+        if (dash != std::string_view::npos) {
+            if (!parse_number(match.substr(0, dash), lo) || !parse_number(match.substr(dash + 1), hi) || lo > hi)
+                return fail(line_no, "bad ID range '" + std::string(match) + "'");
+        } else if (slash != std::string_view::npos) {
+            if (!parse_number(match.substr(0, slash), lo) || !parse_number(match.substr(slash + 1), mask))
+                return fail(line_no, "bad ID mask '" + std::string(match) + "'");
+            hi = lo;
+        } else {
+            if (!parse_number(match, lo)) return fail(line_no, "bad ID '" + std::string(match) + "'");
+            hi = lo;
+        }
+        if (hi > id_max || mask > id_max) return fail(line_no, "ID out of range for " + std::string(words[1]));
+
+        Rule rule;
+        rule.line = line_no;
+        for (size_t i = 3; i < words.size(); ++i) {
+            if (!parse_action(words[i], rule))
+                return fail(line_no, "bad action '" + std::string(words[i]) + "'");
+        }
+
+        if (compiled.rules_.size() >= kNoRule) return fail(line_no, "too many rules");
+        uint16_t index = static_cast<uint16_t>(compiled.rules_.size());
+        compiled.rules_.push_back(rule);
+
+        for (int d = 0; d < 2; ++d) {
+            if (!dirs[d]) continue;
+            Table& table = compiled.tables_[d];
+
+            if (!extended) {
+                for (uint32_t id = 0; id <= CAN_SFF_MASK; ++id) {
+                    bool hit = slash != std::string_view::npos ? (id & mask) == (lo & mask)
+                                                               : (id >= lo && id <= hi);
+                    if (hit && table.standard[id] == kNoRule) table.standard[id] = index;
+                }
+            } else if (slash != std::string_view::npos) {
+                insert_extended(table, mask, lo, index);
+            } else {
+                if (hi - lo >= kMaxExpandedRange)
+                    return fail(line_no, "extended range wider than " + std::to_string(kMaxExpandedRange) +
+                                         " IDs; use <value>/<mask> instead");
+                for (uint32_t id = lo; id <= hi; ++id) insert_extended(table, CAN_EFF_MASK, id, index);
+            }
+        }
+    }
+
+    *this = std::move(compiled);
+    return true;
+}
+
+size_t RuleSet::size() const { return rules_.size(); }
+bool RuleSet::empty() const { return rules_.empty(); }
+
+const Rule* RuleSet::match(Direction direction, uint32_t can_id) const {
+    if (rules_.empty()) return nullptr;
+    const Table& table = tables_[static_cast<size_t>(direction)];
+
+    if (!(can_id & CAN_EFF_FLAG)) {
+        uint16_t index = table.standard[can_id & CAN_SFF_MASK];
+        return index == kNoRule ? nullptr : &rules_[index];
+    }
+
+    uint32_t id = can_id & CAN_EFF_MASK;
+    uint16_t best = kNoRule;
+    for (const auto& cls : table.extended) {
+        auto it = cls.rules.find(id & cls.mask);
+        if (it != cls.rules.end() && it->second < best) best = it->second;
+    }
+    return best == kNoRule ? nullptr : &rules_[best];
+}
+
+void RuleSet::apply_rule(const Rule& rule, uint32_t& can_id, std::span<uint8_t> data) {
+    bool extended = can_id & CAN_EFF_FLAG;
+    uint32_t id = can_id & (extended ? CAN_EFF_MASK : CAN_SFF_MASK);
+
+    for (uint8_t i = 0; i < rule.id_op_count; ++i) {
+        const IdOp& op = rule.id_ops[i];
+        switch (op.kind) {
+            case IdOpKind::Set: id = op.value; break;
+            case IdOpKind::Add: id += op.value; break;
+            case IdOpKind::And: id &= op.value; break;
+            case IdOpKind::Or:  id |= op.value; break;
+        }
+    }
+
+    if (rule.format == Format::Standard) extended = false;
+    else if (rule.format == Format::Extended) extended = true;
+
+    can_id = (can_id & CAN_RTR_FLAG) |
+             (extended ? (id & CAN_EFF_MASK) | CAN_EFF_FLAG : id & CAN_SFF_MASK);
+
+    for (uint8_t i = 0; i < rule.payload_op_count; ++i) {
+        const PayloadOp& op = rule.payload_ops[i];
+        size_t width = op.kind == PayloadOpKind::Swap16 ? 2 : op.kind == PayloadOpKind::Swap32 ? 4 : 1;
+        if (op.offset + width > data.size()) continue;
+
+        uint8_t* p = data.data() + op.offset;
+        switch (op.kind) {
+            case PayloadOpKind::Swap16: std::swap(p[0], p[1]); break;
+            case PayloadOpKind::Swap32: std::reverse(p, p + 4); break;
+            case PayloadOpKind::And:    p[0] &= op.value; break;
+            case PayloadOpKind::Or:     p[0] |= op.value; break;
+            case PayloadOpKind::Set:    p[0] = op.value; break;
+        }
+    }
+}
+
+Verdict RuleSet::apply(Direction direction, uint32_t& can_id, std::span<uint8_t> data) const {
+    const Rule* rule = match(direction, can_id);
+    if (!rule) return Verdict::Unmatched;
+    if (rule->drop) return Verdict::Drop;
+    apply_rule(*rule, can_id, data);
+    return Verdict::Rewritten;
+}
+
+} // namespace can_rules
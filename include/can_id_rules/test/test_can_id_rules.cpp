@@ -0,0 +1,132 @@
+#include "can_id_rules.hpp"
+
+#include <gtest/gtest.h>
+#include <linux/can.h>
+#include <vector>
+#include <string>
+
+using namespace can_rules;
+
+TEST(RuleSetTest, EmptyRuleSetPassesEverything) {
+    RuleSet rules;
+    uint32_t id = 0x123;
+    std::vector<uint8_t> data = {1, 2};
+    EXPECT_TRUE(rules.empty());
+    EXPECT_EQ(rules.apply(Direction::UsbToHost, id, data), Verdict::Unmatched);
+    EXPECT_EQ(id, 0x123u);
+}
+
+TEST(RuleSetTest, StandardRangeOffset) {
+    RuleSet rules;
+    ASSERT_TRUE(rules.load("usb std 0x100-0x17F id+=0x400\n"));
+
+    uint32_t id = 0x142;
+    EXPECT_EQ(rules.apply(Direction::UsbToHost, id, {}), Verdict::Rewritten);
+    EXPECT_EQ(id, 0x542u);
+
+    id = 0x180;
+    EXPECT_EQ(rules.apply(Direction::UsbToHost, id, {}), Verdict::Unmatched);
+
+    // Direction matters.
+    id = 0x142;
+    EXPECT_EQ(rules.apply(Direction::HostToUsb, id, {}), Verdict::Unmatched);
+}
+
+TEST(RuleSetTest, ExtendedMaskRewrite) {
+    RuleSet rules;
+    ASSERT_TRUE(rules.load("host ext 0x18FEF100/0x1FFFFF00 id&=0x1FFFFF00 id|=0x21\n"));
+
+    uint32_t id = 0x18FEF1AB | CAN_EFF_FLAG;
+    EXPECT_EQ(rules.apply(Direction::HostToUsb, id, {}), Verdict::Rewritten);
+    EXPECT_EQ(id, 0x18FEF121u | CAN_EFF_FLAG);
+
+    id = 0x18FEF2AB | CAN_EFF_FLAG;
+    EXPECT_EQ(rules.apply(Direction::HostToUsb, id, {}), Verdict::Unmatched);
+}
+
+TEST(RuleSetTest, FormatChangeAndPayloadActions) {
+    RuleSet rules;
+    ASSERT_TRUE(rules.load("both std 0x321 id=0x18FF0021 ext swap16@2 and@0=0x7F set@5=0xEE swap32@4\n"));
+
+    uint32_t id = 0x321;
+    std::vector<uint8_t> data = {0xFF, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+    EXPECT_EQ(rules.apply(Direction::UsbToHost, id, data), Verdict::Rewritten);
+    EXPECT_EQ(id, 0x18FF0021u | CAN_EFF_FLAG);
+    EXPECT_EQ(data, (std::vector<uint8_t>{0x7F, 0x01, 0x03, 0x02, 0x07, 0x06, 0xEE, 0x04}));
+}
+
+TEST(RuleSetTest, PayloadActionsBeyondDlcAreSkipped) {
+    RuleSet rules;
+    ASSERT_TRUE(rules.load("usb std 0x10 swap32@0 set@1=0xAA\n"));
+    uint32_t id = 0x10;
+    std::vector<uint8_t> data = {0x01, 0x02};
+    EXPECT_EQ(rules.apply(Direction::UsbToHost, id, data), Verdict::Rewritten);
+    EXPECT_EQ(data, (std::vector<uint8_t>{0x01, 0xAA}));
+}
+
+TEST(RuleSetTest, DropRule) {
+    RuleSet rules;
+    ASSERT_TRUE(rules.load("usb std 0x7DF drop\n"));
+    uint32_t id = 0x7DF;
+    EXPECT_EQ(rules.apply(Direction::UsbToHost, id, {}), Verdict::Drop);
+}
+
+TEST(RuleSetTest, FirstRuleWins) {
+    RuleSet rules;
+    ASSERT_TRUE(rules.load(
+        "# specific first\n"
+        "usb ext 0x18DAF110 id=0x1\n"
+        "usb ext 0x18DAF100/0x1FFFFF00 id=0x2\n"
+        "usb std 0x200 id=0x3\n"
+        "usb std 0x200-0x2FF id=0x4\n"));
+
+    uint32_t id = 0x18DAF110 | CAN_EFF_FLAG;
+    rules.apply(Direction::UsbToHost, id, {});
+    EXPECT_EQ(id, 0x1u | CAN_EFF_FLAG);
+
+    id = 0x18DAF111 | CAN_EFF_FLAG;
+    rules.apply(Direction::UsbToHost, id, {});
+    EXPECT_EQ(id, 0x2u | CAN_EFF_FLAG);
+
+    id = 0x200;
+    rules.apply(Direction::UsbToHost, id, {});
+    EXPECT_EQ(id, 0x3u);
+
+    id = 0x201;
+    rules.apply(Direction::UsbToHost, id, {});
+    EXPECT_EQ(id, 0x4u);
+}
+
+TEST(RuleSetTest, StandardResultIsMaskedTo11Bits) {
+    RuleSet rules;
+    ASSERT_TRUE(rules.load("usb std 0x7F0 id+=0x20\n"));
+    uint32_t id = 0x7F0;
+    rules.apply(Direction::UsbToHost, id, {});
+    EXPECT_EQ(id, 0x010u);
+}
+
+TEST(RuleSetTest, RtrFlagIsPreserved) {
+    RuleSet rules;
+    ASSERT_TRUE(rules.load("usb std 0x100 id=0x200\n"));
+    uint32_t id = 0x100 | CAN_RTR_FLAG;
+    rules.apply(Direction::UsbToHost, id, {});
+    EXPECT_EQ(id, 0x200u | CAN_RTR_FLAG);
+}
+
+TEST(RuleSetTest, ReportsErrorsWithLineNumbers) {
+    RuleSet rules;
+    std::string error;
+    EXPECT_FALSE(rules.load("usb std 0x100 id=0x1\nsideways std 0x1 drop\n", &error));
+    EXPECT_NE(error.find("line 2"), std::string::npos);
+
+    EXPECT_FALSE(rules.load("usb std 0x800 drop\n", &error));
+    EXPECT_FALSE(rules.load("usb ext 0x0-0x1FFFFFFF drop\n", &error));
+    EXPECT_FALSE(rules.load("usb std 0x1 frobnicate\n", &error));
+    EXPECT_FALSE(rules.load("usb std 0x1\n", &error));
+    EXPECT_FALSE(rules.load_file("/nonexistent/rules.conf", &error));
+
+    // A failed load leaves the previous rules untouched.
+    ASSERT_TRUE(rules.load("usb std 0x1 drop\n"));
+    EXPECT_FALSE(rules.load("usb std 0x1 bogus\n"));
+    EXPECT_EQ(rules.size(), 1u);
+}
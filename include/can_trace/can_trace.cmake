@@ -0,0 +1,24 @@
+# can_trace.cmake — the `can_trace` library (probe semaphores + header).
+#
+# Components that fire probes link against it instead of adding the include
+# directory by hand, so a standalone component build gets the same
+# CAN_BRIDGE_USDT option and <sys/sdt.h> check as the bridge:
+#   include(${CMAKE_SOURCE_DIR}/../can_trace/can_trace.cmake)
+#   target_link_libraries(<target> can_trace)
+include_guard(GLOBAL)
+
+option(CAN_BRIDGE_USDT "Build USDT static tracepoints" ON)
+include(CheckIncludeFileCXX)
+check_include_file_cxx(sys/sdt.h HAVE_SYS_SDT_H)
+
+# Static, not header-only: each probe's semaphore must be defined exactly once.
+add_library(can_trace STATIC ${CMAKE_CURRENT_LIST_DIR}/src/can_trace.cpp)
+target_include_directories(can_trace PUBLIC
+    ${CMAKE_CURRENT_LIST_DIR}/include
+    ${CMAKE_CURRENT_LIST_DIR}/../can_common/include
+)
+if(CAN_BRIDGE_USDT AND HAVE_SYS_SDT_H)
+    target_compile_definitions(can_trace PUBLIC CAN_BRIDGE_USDT)
+elseif(CAN_BRIDGE_USDT)
+    message(STATUS "can_trace: <sys/sdt.h> not found, USDT probes compiled out")
+endif()
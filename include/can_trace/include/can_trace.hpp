@@ -0,0 +1,69 @@
+// can_trace.hpp — USDT static tracepoints for the bridge hot path
+#pragma once
+
+#include <cstdint>
+#include <time.h>
+
+#include "can_direction.hpp"
+
+// Probes live under the `can_bridge` provider and are listed with
+//   bpftrace -l 'usdt:./can_bridge:can_bridge:*'
+//
+// With CAN_BRIDGE_USDT defined and <sys/sdt.h> available each probe is
+// guarded by its SDT semaphore, which the tracer increments while attached:
+// unattached, a probe costs one load and a not-taken branch, and its
+// arguments (timestamps included) are never evaluated. Otherwise CAN_TRACE
+// expands to nothing.
+//
+// Timestamps are CLOCK_MONOTONIC nanoseconds, the same clock as bpftrace's
+// nsecs, so probe arguments and probe firing times can be compared directly.
+//
+// Every probe must be listed in CAN_TRACE_PROBES, which declares its
+// semaphore; src/can_trace.cpp defines them.
+#define CAN_TRACE_PROBES(X) \
+    X(serial_read)          \
+    X(frame_parsed)         \
+    X(checksum_failure)     \
+    X(stop_byte_error)      \
+    X(usb_send)             \
+    X(usb_queue_enqueue)    \
+    X(usb_queue_dequeue)    \
+    X(socket_recv)          \
+    X(socket_send)          \
+    X(forward_begin)        \
+    X(forward_end)
+
+#if defined(CAN_BRIDGE_USDT) && __has_include(<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define CAN_TRACE_SEMAPHORE(probe) can_bridge_##probe##_semaphore
+#define CAN_TRACE_DECLARE_SEMAPHORE(probe) \
+    extern volatile unsigned short CAN_TRACE_SEMAPHORE(probe) __attribute__((unused, section(".probes")));
+CAN_TRACE_PROBES(CAN_TRACE_DECLARE_SEMAPHORE)
+#undef CAN_TRACE_DECLARE_SEMAPHORE
+
+#define CAN_TRACE_ENABLED(probe) __builtin_expect(CAN_TRACE_SEMAPHORE(probe) != 0, 0)
+#define CAN_TRACE(probe, ...)                                   \
+    do {                                                        \
+        if (CAN_TRACE_ENABLED(probe))                           \
+            STAP_PROBEV(can_bridge, probe, __VA_ARGS__);        \
+    } while (0)
+#define CAN_TRACE_COMPILED 1
+#else
+#define CAN_TRACE_ENABLED(probe) false
+#define CAN_TRACE(probe, ...) do {} while (0)
+#define CAN_TRACE_COMPILED 0
+#endif
+
+namespace can_trace {
+
+inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+using Direction = can_common::Direction;
+
+} // namespace can_trace
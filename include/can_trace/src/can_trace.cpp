@@ -0,0 +1,10 @@
+// can_trace.cpp — SDT semaphores for the probes in CAN_TRACE_PROBES
+#include "can_trace.hpp"
+
+#if CAN_TRACE_COMPILED
+// A tracer finds each semaphore through its probe's SDT note and increments
+// it while attached. They live in .probes, as dtrace -G would place them.
+#define CAN_TRACE_DEFINE_SEMAPHORE(probe) \
+    volatile unsigned short CAN_TRACE_SEMAPHORE(probe) __attribute__((section(".probes"))) = 0;
+CAN_TRACE_PROBES(CAN_TRACE_DEFINE_SEMAPHORE)
+#endif
@@ -1,21 +1,39 @@
 // example/main_with_flags.cpp
 #include "can_usb_interface.hpp"
+#include "loopback_probe.hpp"
 #include <chrono>
 #include <thread>
 #include <iostream>
 #include <numeric>
 #include <iomanip>
 #include <cstring>
+#include <sstream>
+#include <linux/can.h>
 
 void print_usage() {
     std::cout << "Usage: can_usb_test [options]\n"
               << "  -d, --device <path>      USB device path (default: /dev/ttyUSB0)\n"
               << "  -b, --baudrate <rate>    Baudrate (default: 2000000)\n"
               << "  -s, --speed <enum>       CAN speed enum [1..12] (default: 1 = 1Mbps)\n"
+              << "      --probe              Measure round-trip latency in loopback-silent mode and exit\n"
+              << "      --probe-baudrates <list> Serial baudrates to sweep, comma-separated; rates the adapter does not answer at are skipped (default: -b)\n"
+              << "      --probe-speeds <list>  CAN speed enums to sweep (default: -s)\n"
+              << "      --probe-dlcs <list>    Probe payload lengths (default: 0,8)\n"
+              << "      --probe-rates <list>   Offered frames/s (default: doubling from 100 past link capacity)\n"
               << "      --debug              Enable debug logging\n"
               << "      --help               Show this help message\n";
 }
 
+std::vector<std::string> split_list(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
 int main(int argc, char* argv[]) {
     using namespace can_usb;
 
@@ -23,6 +41,8 @@ int main(int argc, char* argv[]) {
     int baudrate = 2000000;
     Speed can_speed = Speed::S1000000;
     bool debug = false;
+    bool probe = false;
+    ProbeConfig probe_config;
 
     for (int i = 1; i < argc; ++i) {
         if ((std::strcmp(argv[i], "--device") == 0 || std::strcmp(argv[i], "-d") == 0) && i + 1 < argc) {
@@ -32,6 +52,17 @@ int main(int argc, char* argv[]) {
         } else if ((std::strcmp(argv[i], "--speed") == 0 || std::strcmp(argv[i], "-s") == 0) && i + 1 < argc) {
             int sp = std::stoi(argv[++i]);
             can_speed = static_cast<Speed>(sp);
+        } else if (std::strcmp(argv[i], "--probe") == 0) {
+            probe = true;
+        } else if (std::strcmp(argv[i], "--probe-baudrates") == 0 && i + 1 < argc) {
+            for (const auto& item : split_list(argv[++i])) probe_config.baudrates.push_back(std::stoi(item));
+        } else if (std::strcmp(argv[i], "--probe-speeds") == 0 && i + 1 < argc) {
+            for (const auto& item : split_list(argv[++i])) probe_config.speeds.push_back(static_cast<Speed>(std::stoi(item)));
+        } else if (std::strcmp(argv[i], "--probe-dlcs") == 0 && i + 1 < argc) {
+            probe_config.dlcs.clear();
+            for (const auto& item : split_list(argv[++i])) probe_config.dlcs.push_back(std::stoul(item));
+        } else if (std::strcmp(argv[i], "--probe-rates") == 0 && i + 1 < argc) {
+            for (const auto& item : split_list(argv[++i])) probe_config.rates.push_back(std::stod(item));
         } else if ((std::strcmp(argv[i], "--debug") == 0 || std::strcmp(argv[i], "--verbose") == 0)) {
             debug = true;
         } else if (std::strcmp(argv[i], "--help") == 0) {
@@ -55,22 +86,33 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    if (probe) {
+        LoopbackProbe prober(device_obj, probe_config);
+        auto sweeps = prober.run();
+        if (sweeps.empty()) {
+            std::cerr << "Loopback probe failed: " << prober.error() << std::endl;
+            return 1;
+        }
+        for (const auto& sweep : sweeps) std::cout << format_sweep(sweep) << "\n" << std::endl;
+        return 0;
+    }
+
     std::thread reader([&device_obj]() {
         while (true) {
             auto frame = device_obj.recv_frame();
-            if (frame && frame->size() >= 5 && (*frame)[0] == 0xAA) {
-                const auto& buf = *frame;
-                uint8_t info = buf[1];
-                uint16_t id = buf[2] | (buf[3] << 8);
-                uint8_t dlc = info & 0x0F;
+            if (!frame) continue;
+            auto decoded = CanUsbDevice::decode_data_frame(*frame);
+            if (decoded) {
+                bool extended = decoded->can_id & CAN_EFF_FLAG;
+                uint32_t id = decoded->can_id & (extended ? CAN_EFF_MASK : CAN_SFF_MASK);
 
                 std::ostringstream oss;
-                oss << "← Received ID=0x" << std::hex << std::uppercase << std::setw(3)
-                    << std::setfill('0') << id << " [" << std::dec << int(dlc) << "] ";
+                oss << "← Received ID=0x" << std::hex << std::uppercase << std::setw(extended ? 8 : 3)
+                    << std::setfill('0') << id << " [" << std::dec << decoded->data.size() << "] ";
 
-                for (size_t i = 0; i < dlc && (4 + i) < buf.size(); ++i) {
+                for (uint8_t byte : decoded->data) {
                     oss << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-                        << static_cast<int>(buf[4 + i]) << " ";
+                        << static_cast<int>(byte) << " ";
                 }
 
                 std::cout << oss.str() << std::endl;
@@ -6,6 +6,12 @@
 #include <functional>
 #include <optional>
 #include <mutex>
+#include <utility>
+#include <sys/types.h>
+#include <deque>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
 
 namespace can_usb {
 
@@ -22,6 +28,35 @@ enum class FrameType : uint8_t {
     Standard = 0x01, Extended = 0x02
 };
 
+// A data frame decoded from the serial framing. `can_id` uses the SocketCAN
+// encoding (CAN_EFF_FLAG / CAN_RTR_FLAG); `data` points into the raw frame.
+struct DataFrameView {
+    uint32_t can_id;
+    std::span<const uint8_t> data;
+};
+
+// Nominal CAN bitrate in bit/s for a Speed setting.
+uint32_t speed_to_bitrate(Speed speed);
+
+// Loss accounting for the serial side. Parser counters come from recv_frame();
+// the tty_* counters are TIOCGICOUNT deltas accumulated since open() and stay
+// at zero on drivers (and ptys) that do not implement the ioctl.
+struct LinkCounters {
+    uint64_t frames = 0;
+    uint64_t checksum_errors = 0;
+    uint64_t stop_byte_errors = 0;
+    uint64_t resync_bytes = 0;
+    uint64_t tty_overruns = 0;
+    uint64_t tty_buffer_overruns = 0;
+    uint64_t tty_framing_errors = 0;
+    uint64_t tty_parity_errors = 0;
+
+    uint64_t discarded() const { return checksum_errors + stop_byte_errors; }
+    uint64_t tty_errors() const {
+        return tty_overruns + tty_buffer_overruns + tty_framing_errors + tty_parity_errors;
+    }
+};
+
 class CanUsbDevice {
 public:
     CanUsbDevice(std::string device, int baudrate = 2000000, Speed speed = Speed::S500000,
@@ -31,32 +66,139 @@ public:
     bool open();
     void close();
     bool init();
+    // True once init() has run; settings changes are sent from then on.
+    bool initialized() const;
+
+    // Confirms the adapter is live and accepts settings at the current
+    // baudrate: switches it to loopback-silent mode, sends a probe frame and
+    // waits up to `timeout_ms` for the echo, then applies the configured
+    // settings as init() does. Frames received meanwhile are discarded.
+    bool verify(int timeout_ms);
+    // Sends a probe frame carrying a fresh nonce and waits up to `timeout_ms`
+    // for its echo, leaving the settings alone. Only an adapter that is in a
+    // loopback mode and answering at the current baudrate passes. Frames
+    // received meanwhile are discarded.
+    bool echo_probe(int timeout_ms);
+    // Reconfigures the open port to each candidate baudrate in turn until
+    // verify() succeeds. Returns the working rate, or nullopt (with the
+    // original rate restored) if none answered.
+    std::optional<int> detect_baudrate(std::span<const int> candidates, int timeout_ms);
+    int baudrate() const;
+    // Reconfigures the open port to `baudrate` in place.
+    bool set_baudrate(int baudrate);
+
+    // Adapter settings. Both take effect at once if init() has run, and are
+    // replayed after a reconnect.
+    //
+    // Any thread may call the setters, init() and set_baudrate(). They
+    // serialize with reconnect(), so a change made while the receiving thread
+    // reconnects waits for it and is then sent over the new port. The getters
+    // never block.
+    bool set_speed(Speed speed);
+    Speed speed() const;
+    bool set_mode(Mode mode);
+    Mode mode() const;
 
     bool send_frame(std::span<const uint8_t> frame);
     std::optional<std::vector<uint8_t>> recv_frame();
 
-    bool send_data(FrameType type, uint16_t id, std::span<const uint8_t> data);
+    bool send_data(FrameType type, uint32_t id, std::span<const uint8_t> data);
+    // Same as send_data(), taking a SocketCAN-encoded ID (CAN_EFF_FLAG selects
+    // an extended frame).
+    bool send_can_frame(uint32_t can_id, std::span<const uint8_t> data);
+
+    // Hotplug recovery: a read error or hangup marks the device disconnected.
+    // recv_frame() then waits (up to the reconnect timeout) for the device node
+    // to reappear, reopens it and replays the settings frame. Frames sent while
+    // disconnected are held in a bounded queue and flushed after the settings.
+    bool is_connected() const;
+    bool reconnect(int timeout_ms);
+    void set_reconnect_timeout(int timeout_ms);
+    void set_queue_limit(size_t frames);
+    size_t pending_frames();
+    uint64_t dropped_frames() const;
+    uint64_t reconnect_count() const;
+
+    LinkCounters link_counters();
 
     int get_fd() const;
+    const std::string& device() const;
     void set_debug(bool enable);
     bool is_debug() const;
 
     static int checksum(std::span<const uint8_t> data);
     static bool is_complete(const std::vector<uint8_t>& buf);
+    static std::optional<DataFrameView> decode_data_frame(std::span<const uint8_t> frame);
+    // Bytes a data frame occupies on the serial link.
+    static size_t wire_size(FrameType type, size_t data_len);
+
+    // Standard ID of the verify() probe; it never reaches the bus.
+    static constexpr uint32_t kProbeId = 0x7FF;
+    // Bound on writing one frame while the tty's output buffer is full.
+    static constexpr int kWriteTimeoutMs = 100;
 
 private:
     std::string device_;
-    int baudrate_;
-    Speed can_speed_;
+    // Written under reconnect_mutex_, read anywhere.
+    std::atomic<int> baudrate_;
+    std::atomic<Speed> can_speed_;
+    std::atomic<Mode> mode_ = Mode::Normal;
     int fd_ = -1;
     bool debug_;
     std::function<void(const std::string&)> logger_;
 
+    std::atomic<bool> keep_open_ = false;
+    std::atomic<bool> connected_ = false;
+    std::atomic<bool> initialized_ = false;
+    int watch_fd_ = -1;
+    // Device node (st_rdev, st_ino) fd_ was opened on; a reconnect that
+    // finds a different one is talking to a replugged adapter.
+    std::pair<dev_t, ino_t> node_ = {0, 0};
+    int watch_wd_ = -1;
+    int reconnect_timeout_ms_ = 100;
+    size_t queue_limit_ = 1024;
+    std::deque<std::vector<uint8_t>> pending_;
+    // A frame the adapter has only seen the first partial_sent_ bytes of.
+    // Its parser is still inside that frame, so the rest goes out before
+    // anything else on the same port. Guarded by send_mutex_.
+    std::vector<uint8_t> partial_;
+    size_t partial_sent_ = 0;
+    std::atomic<uint64_t> dropped_ = 0;
+    std::atomic<uint64_t> reconnects_ = 0;
+    std::chrono::steady_clock::time_point disconnected_at_;
+
+    std::vector<uint8_t> rx_buf_;
+    size_t rx_head_ = 0;
+    LinkCounters counters_;
+    bool icount_supported_ = false;
+    unsigned icount_base_[4] = {};
+
     std::mutex send_mutex_;
     std::mutex recv_mutex_;
+    // Also taken by the settings setters, so a reconnect never replays a
+    // half-applied change. Always locked before recv_mutex_/send_mutex_.
+    std::mutex reconnect_mutex_;
 
     void log(const std::string& msg) const;
+    static size_t data_frame_length(uint8_t info);
     bool send_settings();
+    std::vector<uint8_t> settings_frame(Mode mode) const;
+    int open_port(bool report_errors) const;
+    static bool configure_port(int fd, int baudrate, bool report_errors);
+    // Writes the whole frame within kWriteTimeoutMs; `written` reports how far
+    // it got on failure.
+    bool write_all(std::span<const uint8_t> frame, size_t* written = nullptr);
+    // Finishes any partial frame, then writes `frame`. If `frame` itself is
+    // cut short it becomes the partial frame and `started` is set.
+    bool write_frame(std::span<const uint8_t> frame, bool* started = nullptr);
+    bool finish_partial();
+    bool enqueue_pending(std::span<const uint8_t> frame);
+    void mark_disconnected(const std::string& reason);
+    void watch_device_dir();
+    void close_watch();
+    bool wait_for_device_event(int timeout_ms);
+    std::optional<std::vector<uint8_t>> parse_buffered();
+    void reset_icount_base();
 };
 
 } // namespace can_usb
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "can_usb_interface.hpp"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+namespace can_usb {
+
+// In-situ round-trip measurement of the host -> USB -> adapter -> host path.
+// The adapter is switched to a loopback mode, timestamped probe frames are
+// sent at a controlled rate and matched against their echoes.
+struct ProbeConfig {
+    // Host tty rates. Most adapters run their UART at one fixed rate, so
+    // changing ours usually just loses the adapter: each rate is checked with
+    // an echo first, and rates that get none are reported with
+    // ProbeSweep::answered false instead of being swept.
+    std::vector<int> baudrates;          // empty: the device's current rate
+    std::vector<Speed> speeds;           // empty: the device's current speed
+    std::vector<size_t> dlcs = {0, 8};
+    // Offered frame rates in frames/s, ascending. Empty: doubling from 100
+    // until past 1.5x the link capacity.
+    std::vector<double> rates;
+    std::chrono::milliseconds step_duration{200};
+    size_t min_frames = 50;              // per step, whatever the rate
+    std::chrono::milliseconds drain_timeout{100};  // wait for echoes after the last send
+    std::chrono::milliseconds echo_timeout{100};   // loopback check per baudrate and speed
+    Mode mode = Mode::LoopbackSilent;    // LoopbackSilent keeps probes off the bus
+    // Mode::Loopback puts every probe on the bus as well; run() refuses it
+    // unless this is set.
+    bool allow_bus_loopback = false;
+    double max_loss = 0.0;               // fraction of probes a sustained step may lose
+};
+
+struct RttSummary {
+    size_t samples = 0;
+    double min_us = 0;
+    double p50_us = 0;
+    double p90_us = 0;
+    double p99_us = 0;
+    double max_us = 0;
+    double mean_us = 0;
+};
+
+struct ProbeStep {
+    double offered_fps = 0;     // requested rate
+    double sent_fps = 0;        // rate the host actually managed to send at
+    double achieved_fps = 0;    // echoes per second, first send to last echo
+    size_t sent = 0;
+    size_t received = 0;
+    RttSummary rtt;
+    // Median RTT of the last quarter of probes over that of the first: well
+    // above 1 means a queue is building somewhere on the path.
+    double rtt_growth = 0;
+    bool sustained = false;
+
+    size_t lost() const { return sent - received; }
+};
+
+struct ProbeSweep {
+    int baudrate = 0;
+    Speed speed = Speed::S1000000;
+    size_t dlc = 0;
+    double capacity_fps = 0;        // see LoopbackProbe::link_capacity_fps()
+    // False if the adapter did not echo at this baudrate and speed; no steps
+    // were run.
+    bool answered = true;
+    std::vector<ProbeStep> steps;
+    double max_sustainable_fps = 0; // highest offered rate that was sustained
+    // First offered rate where throughput stops tracking the offered load or
+    // the median RTT bends upward; 0 if the sweep never got there.
+    double knee_fps = 0;
+};
+
+class LoopbackProbe {
+public:
+    explicit LoopbackProbe(CanUsbDevice& device, ProbeConfig config = {});
+
+    // Sweeps every baudrate x speed x DLC combination. The device must be open
+    // and initialized; its baudrate, speed and mode are restored afterwards.
+    // Nothing is swept (and error() says why) unless the adapter accepts the
+    // loopback mode and echoes a probe in it.
+    std::vector<ProbeSweep> run();
+    // Why the last run() returned no sweeps; empty otherwise.
+    const std::string& error() const;
+
+    // One step at the device's current settings. The device must already be
+    // in a loopback mode.
+    ProbeStep run_step(size_t dlc, double rate);
+
+    // Frames/s the slower of the serial link (10 bits per byte) and the CAN
+    // bus (worst-case bit stuffing) can carry for a standard frame.
+    static double link_capacity_fps(int baudrate, Speed speed, size_t dlc);
+
+private:
+    CanUsbDevice& device_;
+    ProbeConfig config_;
+    std::string error_;
+
+    ProbeSweep sweep(size_t dlc);
+    std::vector<double> rates_for(double capacity) const;
+};
+
+std::string format_sweep(const ProbeSweep& sweep);
+
+} // namespace can_usb
@@ -1,17 +1,68 @@
 #include "can_usb_interface.hpp"
 #include "termios2_fallback.hpp"
+#include "can_trace.hpp"
 
 #include <termios.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <linux/serial.h>
+#include <linux/can.h>
 #include <iostream>
 #include <sstream>
 #include <cstring>
+#include <cerrno>
+#include <filesystem>
+#include <algorithm>
+#include <thread>
 
 namespace can_usb {
 
+namespace {
+
+// SocketCAN-encoded ID of a raw serial frame for trace probes; 0 for frames
+// that carry none (status replies, settings). Does not check the stop byte.
+[[maybe_unused]] uint32_t trace_id(std::span<const uint8_t> frame) {
+    if (frame.size() < 4 || (frame[1] & 0xC0) != 0xC0) return 0;
+    const uint8_t* p = frame.data();
+    if (p[1] & 0x20) {
+        if (frame.size() < 6) return 0;
+        return (p[2] | (p[3] << 8) | (p[4] << 16) | ((p[5] & 0x1F) << 24)) | CAN_EFF_FLAG;
+    }
+    return (p[2] | (p[3] << 8)) & CAN_SFF_MASK;
+}
+
+// Identity of the device node behind `fd`. A replugged adapter gets a new
+// node even when it reappears under the same path.
+std::pair<dev_t, ino_t> node_identity(int fd) {
+    struct stat st = {};
+    if (fstat(fd, &st) != 0) return {0, 0};
+    return {st.st_rdev, st.st_ino};
+}
+
+} // namespace
+
+uint32_t speed_to_bitrate(Speed speed) {
+    switch (speed) {
+        case Speed::S1000000: return 1000000;
+        case Speed::S800000:  return 800000;
+        case Speed::S500000:  return 500000;
+        case Speed::S400000:  return 400000;
+        case Speed::S250000:  return 250000;
+        case Speed::S200000:  return 200000;
+        case Speed::S125000:  return 125000;
+        case Speed::S100000:  return 100000;
+        case Speed::S50000:   return 50000;
+        case Speed::S20000:   return 20000;
+        case Speed::S10000:   return 10000;
+        case Speed::S5000:    return 5000;
+    }
+    return 0;
+}
+
 CanUsbDevice::CanUsbDevice(std::string device, int baudrate, Speed speed,
                            bool debug, std::function<void(const std::string&)> logger)
     : device_(std::move(device)), baudrate_(baudrate), can_speed_(speed),
@@ -22,6 +73,7 @@ CanUsbDevice::~CanUsbDevice() { close(); }
 void CanUsbDevice::set_debug(bool enable) { debug_ = enable; }
 bool CanUsbDevice::is_debug() const { return debug_; }
 int CanUsbDevice::get_fd() const { return fd_; }
+const std::string& CanUsbDevice::device() const { return device_; }
 
 void CanUsbDevice::log(const std::string& msg) const {
     if (debug_) {
@@ -31,16 +83,37 @@ void CanUsbDevice::log(const std::string& msg) const {
 }
 
 bool CanUsbDevice::open() {
-    fd_ = ::open(device_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (fd_ == -1) {
-        perror("open");
-        return false;
+    fd_ = open_port(true);
+    if (fd_ == -1) return false;
+    node_ = node_identity(fd_);
+
+    keep_open_ = true;
+    connected_ = true;
+    rx_buf_.clear();
+    rx_head_ = 0;
+    reset_icount_base();
+    watch_device_dir();
+    log("Opened USB CAN on " + device_);
+    return true;
+}
+
+int CanUsbDevice::open_port(bool report_errors) const {
+    int fd = ::open(device_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd == -1) {
+        if (report_errors) perror("open");
+        return -1;
+    }
+    if (!configure_port(fd, baudrate_, report_errors)) {
+        ::close(fd);
+        return -1;
     }
+    return fd;
+}
 
+bool CanUsbDevice::configure_port(int fd, int baudrate, bool report_errors) {
     struct termios2 tio;
-    if (ioctl(fd_, TCGETS2, &tio) < 0) {
-        perror("TCGETS2");
-        close();
+    if (ioctl(fd, TCGETS2, &tio) < 0) {
+        if (report_errors) perror("TCGETS2");
         return false;
     }
 
@@ -49,24 +122,191 @@ bool CanUsbDevice::open() {
     tio.c_iflag = IGNPAR;
     tio.c_oflag = 0;
     tio.c_lflag = 0;
-    tio.c_ispeed = baudrate_;
-    tio.c_ospeed = baudrate_;
-
-    if (ioctl(fd_, TCSETS2, &tio) < 0) {
-        perror("TCSETS2");
-        close();
+    // Set explicitly rather than inheriting whatever the tty had: with VMIN=0
+    // an idle line would look like a zero-length read.
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tio.c_ispeed = baudrate;
+    tio.c_ospeed = baudrate;
+
+    if (ioctl(fd, TCSETS2, &tio) < 0) {
+        if (report_errors) perror("TCSETS2");
         return false;
     }
-
-    log("Opened USB CAN on " + device_);
     return true;
 }
 
 void CanUsbDevice::close() {
+    keep_open_ = false;
+    connected_ = false;
+    {
+        std::lock_guard lock(send_mutex_);
+        partial_.clear();
+        partial_sent_ = 0;
+    }
     if (fd_ != -1) {
         ::close(fd_);
         fd_ = -1;
     }
+    close_watch();
+}
+
+bool CanUsbDevice::is_connected() const { return connected_; }
+void CanUsbDevice::set_reconnect_timeout(int timeout_ms) { reconnect_timeout_ms_ = timeout_ms; }
+uint64_t CanUsbDevice::dropped_frames() const { return dropped_; }
+uint64_t CanUsbDevice::reconnect_count() const { return reconnects_; }
+
+void CanUsbDevice::set_queue_limit(size_t frames) {
+    std::lock_guard lock(send_mutex_);
+    queue_limit_ = frames;
+}
+
+size_t CanUsbDevice::pending_frames() {
+    std::lock_guard lock(send_mutex_);
+    return pending_.size();
+}
+
+void CanUsbDevice::mark_disconnected(const std::string& reason) {
+    if (connected_.exchange(false)) {
+        disconnected_at_ = std::chrono::steady_clock::now();
+        log("USB CAN disconnected (" + reason + "), waiting for " + device_);
+    }
+}
+
+bool CanUsbDevice::enqueue_pending(std::span<const uint8_t> frame) {
+    if (pending_.size() >= queue_limit_) {
+        ++dropped_;
+        return false;
+    }
+    pending_.emplace_back(frame.begin(), frame.end());
+    CAN_TRACE(usb_queue_enqueue, trace_id(frame), frame.size(), pending_.size(), can_trace::now_ns());
+    return true;
+}
+
+void CanUsbDevice::watch_device_dir() {
+    if (watch_fd_ == -1) {
+        watch_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watch_fd_ == -1) return;
+    }
+    if (watch_wd_ == -1) {
+        std::filesystem::path dir = std::filesystem::path(device_).parent_path();
+        if (dir.empty()) dir = ".";
+        watch_wd_ = inotify_add_watch(watch_fd_, dir.c_str(),
+                                      IN_CREATE | IN_ATTRIB | IN_MOVED_TO | IN_DELETE_SELF);
+    }
+}
+
+void CanUsbDevice::close_watch() {
+    if (watch_fd_ != -1) {
+        ::close(watch_fd_);
+        watch_fd_ = -1;
+        watch_wd_ = -1;
+    }
+}
+
+bool CanUsbDevice::wait_for_device_event(int timeout_ms) {
+    // Without a usable watch (no inotify, or the directory itself went away)
+    // fall back to retrying the open on a short fixed interval.
+    if (watch_fd_ == -1 || watch_wd_ == -1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeout_ms, 10)));
+        watch_device_dir();
+        return false;
+    }
+
+    struct pollfd pfd = { watch_fd_, POLLIN, 0 };
+    if (poll(&pfd, 1, timeout_ms) <= 0) return false;
+
+    alignas(struct inotify_event) char buf[4096];
+    const std::string name = std::filesystem::path(device_).filename();
+    bool relevant = false;
+    ssize_t n;
+    while ((n = ::read(watch_fd_, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + n;) {
+            auto* ev = reinterpret_cast<struct inotify_event*>(p);
+            if (ev->mask & IN_IGNORED) watch_wd_ = -1;
+            if (ev->len > 0 && name == ev->name) relevant = true;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return relevant;
+}
+
+bool CanUsbDevice::reconnect(int timeout_ms) {
+    std::lock_guard reconnect_lock(reconnect_mutex_);
+    if (!keep_open_) return false;
+    if (connected_) return true;
+
+    {
+        std::scoped_lock lock(recv_mutex_, send_mutex_);
+        if (fd_ != -1) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    int fd;
+    while ((fd = open_port(false)) == -1) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) return false;
+        wait_for_device_event(static_cast<int>(remaining));
+    }
+
+    size_t flushed = 0;
+    {
+        std::scoped_lock lock(recv_mutex_, send_mutex_);
+        fd_ = fd;
+        rx_buf_.clear();
+        rx_head_ = 0;
+        reset_icount_base();
+
+        auto node = node_identity(fd_);
+        bool replugged = node != node_;
+        node_ = node;
+
+        // A node that went away came back as a new adapter whose parser starts
+        // clean, so a frame it only partly saw is resent whole. On a node
+        // that never went away the parser may still be inside that frame:
+        // finish_partial() completes it before the settings, or the adapter
+        // would swallow their first bytes.
+        if (replugged && !partial_.empty()) {
+            pending_.push_front(std::move(partial_));
+            partial_.clear();
+            partial_sent_ = 0;
+        }
+
+        if (!finish_partial() || (initialized_ && !write_frame(settings_frame(mode_)))) {
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+
+        while (!pending_.empty()) {
+            bool started = false;
+            if (!write_frame(pending_.front(), &started)) {
+                // A started frame now lives in partial_; keep only one copy.
+                if (started) pending_.pop_front();
+                ::close(fd_);
+                fd_ = -1;
+                return false;
+            }
+            CAN_TRACE(usb_queue_dequeue, trace_id(pending_.front()), pending_.front().size(),
+                      pending_.size() - 1, can_trace::now_ns());
+            pending_.pop_front();
+            ++flushed;
+        }
+        connected_ = true;
+    }
+    ++reconnects_;
+
+    auto down_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - disconnected_at_).count();
+    std::ostringstream oss;
+    oss << "Reconnected USB CAN on " << device_ << " after " << down_ms
+        << " ms, flushed " << flushed << " queued frames";
+    log(oss.str());
+    return true;
 }
 
 int CanUsbDevice::checksum(std::span<const uint8_t> data) {
@@ -75,6 +315,13 @@ int CanUsbDevice::checksum(std::span<const uint8_t> data) {
     return sum & 0xFF;
 }
 
+// Info byte of a data frame: 0b11 E R LLLL — E selects a 4-byte extended ID,
+// R marks a remote frame, LLLL is the DLC.
+size_t CanUsbDevice::data_frame_length(uint8_t info) {
+    if ((info & 0xC0) != 0xC0 || (info & 0x0F) > 8) return 0;
+    return 1 + 1 + ((info & 0x20) ? 4 : 2) + (info & 0x0F) + 1;
+}
+
 bool CanUsbDevice::is_complete(const std::vector<uint8_t>& buf) {
     if (buf.size() < 2) return false;
     if (buf[0] != 0xAA) return true;
@@ -84,19 +331,115 @@ bool CanUsbDevice::is_complete(const std::vector<uint8_t>& buf) {
     if (info == 0x55)
         return buf.size() >= 20;
 
-    if ((info >> 4) == 0xC) {
-        size_t expected_len = 1 + 1 + 2 + (info & 0x0F) + 1;
+    if (size_t expected_len = data_frame_length(info))
         return buf.size() >= expected_len;
+
+    return true;
+}
+
+std::optional<DataFrameView> CanUsbDevice::decode_data_frame(std::span<const uint8_t> frame) {
+    if (frame.size() < 2 || frame[0] != 0xAA) return std::nullopt;
+    uint8_t info = frame[1];
+    size_t len = data_frame_length(info);
+    if (len == 0 || frame.size() != len) return std::nullopt;
+
+    uint32_t can_id = frame[2] | (frame[3] << 8);
+    size_t data_off = 4;
+    if (info & 0x20) {
+        can_id |= (static_cast<uint32_t>(frame[4]) << 16) | (static_cast<uint32_t>(frame[5]) << 24);
+        can_id = (can_id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+        data_off = 6;
+    } else {
+        can_id &= CAN_SFF_MASK;
     }
+    if (info & 0x10) can_id |= CAN_RTR_FLAG;
 
+    return DataFrameView{can_id, frame.subspan(data_off, info & 0x0F)};
+}
+
+bool CanUsbDevice::write_all(std::span<const uint8_t> frame, size_t* written) {
+    // One deadline covers the whole frame: giving up halfway would leave a
+    // truncated frame on the wire for the adapter's parser to choke on.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kWriteTimeoutMs);
+    size_t off = 0;
+    if (written) *written = 0;
+    while (off < frame.size()) {
+        ssize_t n = ::write(fd_, frame.data() + off, frame.size() - off);
+        if (n > 0) {
+            off += n;
+            if (written) *written = off;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) {
+                errno = ETIMEDOUT;
+                return false;
+            }
+            struct pollfd pfd = { fd_, POLLOUT, 0 };
+            int r = poll(&pfd, 1, static_cast<int>(remaining));
+            if (r > 0 && (pfd.revents & (POLLERR | POLLHUP))) {
+                errno = EIO;
+                return false;
+            }
+            continue;
+        }
+        return false;
+    }
     return true;
 }
 
+size_t CanUsbDevice::wire_size(FrameType type, size_t data_len) {
+    // 0xAA, info byte, ID (2 or 4 bytes), payload, 0x55
+    return 1 + 1 + (type == FrameType::Extended ? 4 : 2) + data_len + 1;
+}
+
+bool CanUsbDevice::finish_partial() {
+    if (partial_.empty()) return true;
+    size_t written = 0;
+    bool ok = write_all({partial_.data() + partial_sent_, partial_.size() - partial_sent_}, &written);
+    partial_sent_ += written;
+    if (ok) {
+        partial_.clear();
+        partial_sent_ = 0;
+    }
+    return ok;
+}
+
+bool CanUsbDevice::write_frame(std::span<const uint8_t> frame, bool* started) {
+    if (started) *started = false;
+    if (!finish_partial()) return false;
+
+    size_t written = 0;
+    if (write_all(frame, &written)) return true;
+    if (written > 0) {
+        partial_.assign(frame.begin(), frame.end());
+        partial_sent_ = written;
+        if (started) *started = true;
+    }
+    return false;
+}
+
 bool CanUsbDevice::send_frame(std::span<const uint8_t> frame) {
     std::lock_guard lock(send_mutex_);
-    if (fd_ < 0 || frame.empty()) return false;
-
-    if (::write(fd_, frame.data(), frame.size()) < 0) {
+    if (frame.empty()) return false;
+    if (!connected_) return keep_open_ && enqueue_pending(frame);
+
+    bool started = false;
+    if (!write_frame(frame, &started)) {
+        // A frame that was started is now owed to the adapter's parser and
+        // finished ahead of the next write (or requeued whole if the adapter
+        // turns out to have been replugged), so it is not queued again here.
+        if (errno == EIO || errno == ENODEV || errno == ENXIO || errno == EPIPE) {
+            mark_disconnected(std::strerror(errno));
+            return started || enqueue_pending(frame);
+        }
+        if (started) {
+            log("USB CAN write stalled mid-frame; finishing it before the next one");
+            return true;
+        }
         perror("send_frame");
         return false;
     }
@@ -107,75 +450,276 @@ bool CanUsbDevice::send_frame(std::span<const uint8_t> frame) {
     return true;
 }
 
+std::optional<std::vector<uint8_t>> CanUsbDevice::parse_buffered() {
+    while (rx_head_ < rx_buf_.size()) {
+        const uint8_t* p = rx_buf_.data() + rx_head_;
+        size_t avail = rx_buf_.size() - rx_head_;
+
+        if (p[0] != 0xAA) {
+            ++counters_.resync_bytes;
+            ++rx_head_;
+            continue;
+        }
+        if (avail < 2) return std::nullopt;
+
+        uint8_t info = p[1];
+        size_t len = info == 0x55 ? 20 : data_frame_length(info);
+        if (len == 0) {
+            ++counters_.resync_bytes;
+            ++rx_head_;
+            continue;
+        }
+        if (avail < len) return std::nullopt;
+
+        // A bad frame only costs its start byte: parsing resumes at the next
+        // 0xAA, which may well be the real start of the following frame.
+        if (info == 0x55) {
+            if (checksum({p + 2, p + 19}) != p[19]) {
+                ++counters_.checksum_errors;
+                CAN_TRACE(checksum_failure, len, can_trace::now_ns());
+                log("Checksum mismatch");
+                ++rx_head_;
+                continue;
+            }
+        } else if (p[len - 1] != 0x55) {
+            ++counters_.stop_byte_errors;
+            CAN_TRACE(stop_byte_error, trace_id({p, len}), len, can_trace::now_ns());
+            log("Frame missing stop byte");
+            ++rx_head_;
+            continue;
+        }
+
+        std::vector<uint8_t> frame(p, p + len);
+        rx_head_ += len;
+        ++counters_.frames;
+        CAN_TRACE(frame_parsed, trace_id({p, len}), len, can_trace::now_ns());
+        return frame;
+    }
+    return std::nullopt;
+}
+
 std::optional<std::vector<uint8_t>> CanUsbDevice::recv_frame() {
+    if (!connected_ && !reconnect(reconnect_timeout_ms_)) return std::nullopt;
+
     std::lock_guard lock(recv_mutex_);
     if (fd_ < 0) return std::nullopt;
 
-    std::vector<uint8_t> frame;
-    frame.reserve(24);
-    uint8_t byte;
-
     while (true) {
-        int n = ::read(fd_, &byte, 1);
-        if (n <= 0) return std::nullopt;
-
-        frame.push_back(byte);
-        if (is_complete(frame)) break;
-    }
+        if (auto frame = parse_buffered()) {
+            std::ostringstream oss;
+            oss << "← Received frame USBCAN: " << frame->size() << " bytes";
+            log(oss.str());
+            return frame;
+        }
 
-    if (frame.size() == 20 && frame[0] == 0xAA && frame[1] == 0x55) {
-        int chk = checksum({frame.begin() + 2, frame.begin() + 19});
-        if (chk != frame.back()) {
-            log("Checksum mismatch");
+        // Keep the unparsed tail at the front so the buffer stays small.
+        rx_buf_.erase(rx_buf_.begin(), rx_buf_.begin() + rx_head_);
+        rx_head_ = 0;
+
+        uint8_t chunk[256];
+        ssize_t n = ::read(fd_, chunk, sizeof(chunk));
+        if (n == 0) {
+            // Zero bytes alone is not an unplug; only trust the tty's hangup flag.
+            struct pollfd pfd = { fd_, POLLIN, 0 };
+            if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR)))
+                mark_disconnected("hangup");
             return std::nullopt;
         }
+        if (n < 0) {
+            if (errno == EIO || errno == ENODEV || errno == ENXIO)
+                mark_disconnected(std::strerror(errno));
+            return std::nullopt;
+        }
+        CAN_TRACE(serial_read, n, rx_buf_.size() - rx_head_, can_trace::now_ns());
+        rx_buf_.insert(rx_buf_.end(), chunk, chunk + n);
     }
+}
 
-    if (!frame.empty() && frame.back() != 0x55) {
-        log("Frame missing stop byte");
-        return std::nullopt;
+void CanUsbDevice::reset_icount_base() {
+    struct serial_icounter_struct ic;
+    icount_supported_ = fd_ != -1 && ioctl(fd_, TIOCGICOUNT, &ic) == 0;
+    if (icount_supported_) {
+        icount_base_[0] = ic.overrun;
+        icount_base_[1] = ic.buf_overrun;
+        icount_base_[2] = ic.frame;
+        icount_base_[3] = ic.parity;
     }
+}
 
-    std::ostringstream oss;
-    oss << "← Received frame USBCAN: " << frame.size() << " bytes";
-    log(oss.str());
+LinkCounters CanUsbDevice::link_counters() {
+    std::lock_guard lock(recv_mutex_);
 
-    return frame;
+    struct serial_icounter_struct ic;
+    if (icount_supported_ && fd_ != -1 && ioctl(fd_, TIOCGICOUNT, &ic) == 0) {
+        // The driver's counters are free-running; fold in what changed since
+        // the last look so the totals survive reconnects.
+        auto fold = [](uint64_t& total, unsigned& base, int now) {
+            total += static_cast<unsigned>(now) - base;
+            base = static_cast<unsigned>(now);
+        };
+        fold(counters_.tty_overruns, icount_base_[0], ic.overrun);
+        fold(counters_.tty_buffer_overruns, icount_base_[1], ic.buf_overrun);
+        fold(counters_.tty_framing_errors, icount_base_[2], ic.frame);
+        fold(counters_.tty_parity_errors, icount_base_[3], ic.parity);
+    }
+    return counters_;
 }
 
-bool CanUsbDevice::send_data(FrameType type, uint16_t id, std::span<const uint8_t> data) {
+bool CanUsbDevice::send_data(FrameType type, uint32_t id, std::span<const uint8_t> data) {
     if (data.size() > 8) return false;
 
     std::vector<uint8_t> frame;
-    frame.reserve(13);
+    frame.reserve(15);
     frame.push_back(0xAA);
     uint8_t info = 0xC0 | (type == FrameType::Extended ? 0x20 : 0x00);
     info |= data.size() & 0x0F;
     frame.push_back(info);
     frame.push_back(id & 0xFF);
     frame.push_back((id >> 8) & 0xFF);
+    if (type == FrameType::Extended) {
+        frame.push_back((id >> 16) & 0xFF);
+        frame.push_back((id >> 24) & 0x1F);
+    }
     frame.insert(frame.end(), data.begin(), data.end());
     frame.push_back(0x55);
 
-    return send_frame(frame);
+    if (!send_frame(frame)) return false;
+    CAN_TRACE(usb_send, (type == FrameType::Extended ? id | CAN_EFF_FLAG : id), data.size(), can_trace::now_ns());
+    return true;
 }
 
-bool CanUsbDevice::send_settings() {
+bool CanUsbDevice::send_can_frame(uint32_t can_id, std::span<const uint8_t> data) {
+    if (can_id & CAN_EFF_FLAG)
+        return send_data(FrameType::Extended, can_id & CAN_EFF_MASK, data);
+    return send_data(FrameType::Standard, can_id & CAN_SFF_MASK, data);
+}
+
+std::vector<uint8_t> CanUsbDevice::settings_frame(Mode mode) const {
+    // 0xAA 0x55 0x12, speed, frame type, filter ID (4), mask ID (4), mode,
+    // 0x01, 4 reserved bytes, checksum over everything after 0xAA 0x55.
     std::vector<uint8_t> frame = {
         0xAA, 0x55, 0x12,
-        static_cast<uint8_t>(can_speed_),
+        static_cast<uint8_t>(can_speed_.load()),
         static_cast<uint8_t>(FrameType::Standard),
         0,0,0,0, 0,0,0,0,
-        static_cast<uint8_t>(Mode::Normal), 0x01,
-        0,0,0,0, 0x00
+        static_cast<uint8_t>(mode), 0x01,
+        0,0,0,0
     };
-    int chk = checksum({frame.begin() + 2, frame.begin() + 19});
+    int chk = checksum({frame.begin() + 2, frame.end()});
     frame.push_back(chk);
-    return send_frame(frame);
+    return frame;
+}
+
+bool CanUsbDevice::send_settings() {
+    return send_frame(settings_frame(mode_));
 }
 
 bool CanUsbDevice::init() {
+    std::lock_guard settings_lock(reconnect_mutex_);
+    initialized_ = true;
     return send_settings();
 }
 
+bool CanUsbDevice::initialized() const { return initialized_; }
+
+int CanUsbDevice::baudrate() const { return baudrate_; }
+
+bool CanUsbDevice::set_baudrate(int baudrate) {
+    std::lock_guard settings_lock(reconnect_mutex_);
+    std::scoped_lock lock(recv_mutex_, send_mutex_);
+    if (fd_ == -1) return false;
+    if (!configure_port(fd_, baudrate, debug_)) return false;
+    baudrate_ = baudrate;
+    rx_buf_.clear();
+    rx_head_ = 0;
+    return true;
+}
+
+bool CanUsbDevice::set_speed(Speed speed) {
+    std::lock_guard settings_lock(reconnect_mutex_);
+    can_speed_ = speed;
+    return !initialized_ || send_settings();
+}
+
+Speed CanUsbDevice::speed() const { return can_speed_; }
+
+bool CanUsbDevice::set_mode(Mode mode) {
+    std::lock_guard settings_lock(reconnect_mutex_);
+    mode_ = mode;
+    return !initialized_ || send_settings();
+}
+
+Mode CanUsbDevice::mode() const { return mode_; }
+
+bool CanUsbDevice::echo_probe(int timeout_ms) {
+    if (fd_ == -1) return false;
+
+    // A nonce in the payload keeps a stale echo from a previous attempt (or a
+    // frame that was on the wire before a mode switch) from counting.
+    static std::atomic<uint32_t> probe_seq = 0;
+    uint32_t seq = ++probe_seq;
+    uint64_t stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    std::vector<uint8_t> nonce = {
+        static_cast<uint8_t>(seq), static_cast<uint8_t>(seq >> 8),
+        static_cast<uint8_t>(stamp), static_cast<uint8_t>(stamp >> 8),
+        static_cast<uint8_t>(stamp >> 16), static_cast<uint8_t>(stamp >> 24),
+        static_cast<uint8_t>(stamp >> 32), static_cast<uint8_t>(stamp >> 40)
+    };
+
+    {
+        std::lock_guard lock(recv_mutex_);
+        tcflush(fd_, TCIFLUSH);
+        rx_buf_.clear();
+        rx_head_ = 0;
+    }
+    if (!send_data(FrameType::Standard, kProbeId, nonce)) return false;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) return false;
+
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, static_cast<int>(remaining)) <= 0) continue;
+        while (auto frame = recv_frame()) {
+            auto view = decode_data_frame(*frame);
+            if (view && view->can_id == kProbeId &&
+                std::equal(view->data.begin(), view->data.end(), nonce.begin(), nonce.end())) {
+                return true;
+            }
+        }
+    }
+}
+
+bool CanUsbDevice::verify(int timeout_ms) {
+    if (fd_ == -1) return false;
+
+    // The settings frame gets no reply, so prove the adapter parsed it: in
+    // loopback-silent mode it echoes what it transmits without touching the
+    // bus.
+    bool echoed = send_frame(settings_frame(Mode::LoopbackSilent)) && echo_probe(timeout_ms);
+
+    // Back to the configured mode whatever the outcome, so a slow adapter that
+    // answers late is not left in loopback.
+    bool restored = init();
+    std::ostringstream oss;
+    oss << "USB CAN on " << device_ << (echoed ? " verified" : " did not answer")
+        << " at " << baudrate_ << " baud";
+    log(oss.str());
+    return echoed && restored;
+}
+
+std::optional<int> CanUsbDevice::detect_baudrate(std::span<const int> candidates, int timeout_ms) {
+    if (fd_ == -1) return std::nullopt;
+
+    const int original = baudrate_;
+    for (int rate : candidates) {
+        if (set_baudrate(rate) && verify(timeout_ms)) return rate;
+    }
+
+    set_baudrate(original);
+    return std::nullopt;
+}
+
 } // namespace can_usb
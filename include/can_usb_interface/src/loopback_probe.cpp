@@ -0,0 +1,310 @@
+// loopback_probe.cpp
+#include "loopback_probe.hpp"
+#include "can_trace.hpp"
+
+#include <linux/can.h>
+#include <poll.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <optional>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+namespace can_usb {
+
+namespace {
+
+// Probe IDs carry the sequence number modulo 2048, so an echo can be matched
+// after losses as long as fewer than 2048 probes in a row go missing.
+constexpr uint32_t kSequenceMask = CAN_SFF_MASK;
+
+// A step only counts as sustained if it keeps up with the offered load...
+constexpr double kKeepUp = 0.9;
+// ...and its RTT does not climb by more than this over the step.
+constexpr double kGrowthFactor = 2.0;
+constexpr double kGrowthSlackUs = 500.0;
+
+// A sweep gives up after this many unsustained steps in a row.
+constexpr int kFailedStepsToStop = 2;
+
+bool rtt_climbed(double before_us, double after_us) {
+    return after_us > kGrowthFactor * before_us + kGrowthSlackUs;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = static_cast<size_t>(std::ceil(p * sorted.size())) - 1;
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+double median_of(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return percentile(values, 0.5);
+}
+
+RttSummary summarize(std::vector<double> rtt_us) {
+    RttSummary s;
+    s.samples = rtt_us.size();
+    if (rtt_us.empty()) return s;
+    std::sort(rtt_us.begin(), rtt_us.end());
+    s.min_us = rtt_us.front();
+    s.max_us = rtt_us.back();
+    s.p50_us = percentile(rtt_us, 0.50);
+    s.p90_us = percentile(rtt_us, 0.90);
+    s.p99_us = percentile(rtt_us, 0.99);
+    double sum = 0;
+    for (double v : rtt_us) sum += v;
+    s.mean_us = sum / rtt_us.size();
+    return s;
+}
+
+} // namespace
+
+LoopbackProbe::LoopbackProbe(CanUsbDevice& device, ProbeConfig config)
+    : device_(device), config_(std::move(config)) {}
+
+double LoopbackProbe::link_capacity_fps(int baudrate, Speed speed, size_t dlc) {
+    // SOF through CRC (1 + 11 + 3 + 4 + data + 15 bits) is stuffed; the CRC
+    // delimiter, ACK, EOF and IFS (13 bits) are not. Probe payloads are send
+    // timestamps, so rather than counting actual stuff bits (as
+    // BusStatistics::frame_bits() does) this takes the worst case: one stuff
+    // bit after the first five, then one per four.
+    size_t stuffed = 34 + 8 * dlc;
+    double bus_bits = stuffed + 13 + (stuffed - 1) / 4;
+    double bus_fps = speed_to_bitrate(speed) / bus_bits;
+    double serial_fps = baudrate / (10.0 * CanUsbDevice::wire_size(FrameType::Standard, dlc));
+    return std::min(bus_fps, serial_fps);
+}
+
+std::vector<double> LoopbackProbe::rates_for(double capacity) const {
+    if (!config_.rates.empty()) return config_.rates;
+    std::vector<double> rates;
+    for (double rate = 100; ; rate *= 2) {
+        rates.push_back(rate);
+        if (rate > 1.5 * capacity) break;
+    }
+    return rates;
+}
+
+ProbeStep LoopbackProbe::run_step(size_t dlc, double rate) {
+    ProbeStep step;
+    step.offered_fps = rate;
+    dlc = std::min<size_t>(dlc, 8);
+
+    const size_t frames = std::max(config_.min_frames,
+        static_cast<size_t>(rate * config_.step_duration.count() / 1000.0));
+    std::vector<uint64_t> sent_ns(frames, 0);
+    std::vector<uint64_t> rtt_ns(frames, 0);
+    std::atomic<size_t> sent = 0;
+
+    // Leftover echoes from a previous step would only confuse the matching.
+    while (device_.recv_frame()) {}
+
+    // The send time is kept here by sequence number and also rides in the
+    // payload, so an echo is only accepted if it carries the stamp we sent.
+    std::thread sender([&]() {
+        const auto interval = std::chrono::duration<double>(1.0 / rate);
+        const auto start = std::chrono::steady_clock::now();
+        std::array<uint8_t, 8> payload{};
+        for (size_t i = 0; i < frames; ++i) {
+            auto target = start + std::chrono::duration_cast<std::chrono::nanoseconds>(interval * i);
+            if (target - std::chrono::steady_clock::now() > std::chrono::microseconds(200))
+                std::this_thread::sleep_until(target - std::chrono::microseconds(100));
+            while (std::chrono::steady_clock::now() < target) {}
+
+            uint64_t stamp = can_trace::now_ns();
+            for (size_t b = 0; b < dlc; ++b) payload[b] = static_cast<uint8_t>(stamp >> (8 * b));
+            sent_ns[i] = stamp;
+            sent.store(i + 1, std::memory_order_release);
+            device_.send_data(FrameType::Standard, i & kSequenceMask, {payload.data(), dlc});
+        }
+    });
+
+    size_t next = 0;
+    uint64_t last_rx = 0;
+    std::optional<std::chrono::steady_clock::time_point> drain_deadline;
+    while (true) {
+        if (!drain_deadline && sent.load(std::memory_order_acquire) == frames)
+            drain_deadline = std::chrono::steady_clock::now() + config_.drain_timeout;
+        if (drain_deadline && (step.received == frames || std::chrono::steady_clock::now() >= *drain_deadline))
+            break;
+
+        struct pollfd pfd = { device_.get_fd(), POLLIN, 0 };
+        if (poll(&pfd, 1, 5) <= 0) continue;
+        while (auto frame = device_.recv_frame()) {
+            uint64_t now = can_trace::now_ns();
+            auto view = CanUsbDevice::decode_data_frame(*frame);
+            if (!view || (view->can_id & CAN_EFF_FLAG) || view->data.size() != dlc) continue;
+
+            size_t seq = next + ((view->can_id - next) & kSequenceMask);
+            if (seq >= sent.load(std::memory_order_acquire)) continue;
+            bool stamped = true;
+            for (size_t b = 0; b < dlc; ++b)
+                stamped &= view->data[b] == static_cast<uint8_t>(sent_ns[seq] >> (8 * b));
+            if (!stamped) continue;
+
+            rtt_ns[seq] = now - sent_ns[seq];
+            ++step.received;
+            next = seq + 1;
+            last_rx = now;
+        }
+    }
+    sender.join();
+
+    step.sent = frames;
+    if (frames > 1 && sent_ns.back() > sent_ns.front())
+        step.sent_fps = (frames - 1) * 1e9 / (sent_ns.back() - sent_ns.front());
+    if (step.received > 0 && last_rx > sent_ns.front())
+        step.achieved_fps = step.received * 1e9 / (last_rx - sent_ns.front());
+
+    std::vector<double> rtt_us;
+    rtt_us.reserve(step.received);
+    for (size_t i = 0; i < frames; ++i) {
+        if (rtt_ns[i]) rtt_us.push_back(rtt_ns[i] / 1e3);
+    }
+    step.rtt = summarize(rtt_us);
+
+    bool climbed = false;
+    if (rtt_us.size() >= 8) {
+        size_t quarter = rtt_us.size() / 4;
+        double early = median_of({rtt_us.begin(), rtt_us.begin() + quarter});
+        double late = median_of({rtt_us.end() - quarter, rtt_us.end()});
+        step.rtt_growth = early > 0 ? late / early : 0;
+        climbed = rtt_climbed(early, late);
+    }
+
+    step.sustained = step.received > 0 &&
+                     step.lost() <= config_.max_loss * step.sent &&
+                     step.achieved_fps >= kKeepUp * rate &&
+                     !climbed;
+    return step;
+}
+
+ProbeSweep LoopbackProbe::sweep(size_t dlc) {
+    ProbeSweep sweep;
+    sweep.baudrate = device_.baudrate();
+    sweep.speed = device_.speed();
+    sweep.dlc = dlc;
+    sweep.capacity_fps = link_capacity_fps(sweep.baudrate, sweep.speed, dlc);
+
+    int failed = 0;
+    for (double rate : rates_for(sweep.capacity_fps)) {
+        sweep.steps.push_back(run_step(dlc, rate));
+        const ProbeStep& step = sweep.steps.back();
+
+        if (step.sustained) sweep.max_sustainable_fps = std::max(sweep.max_sustainable_fps, rate);
+        bool bent = !step.sustained || rtt_climbed(sweep.steps.front().rtt.p50_us, step.rtt.p50_us);
+        if (sweep.knee_fps == 0 && bent) sweep.knee_fps = rate;
+
+        failed = step.sustained ? 0 : failed + 1;
+        if (failed >= kFailedStepsToStop) break;
+    }
+    return sweep;
+}
+
+std::vector<ProbeSweep> LoopbackProbe::run() {
+    std::vector<ProbeSweep> sweeps;
+    error_.clear();
+    if (device_.get_fd() == -1 || !device_.initialized()) {
+        error_ = "device is not open and initialized";
+        return sweeps;
+    }
+    if (config_.mode != Mode::LoopbackSilent &&
+        !(config_.mode == Mode::Loopback && config_.allow_bus_loopback)) {
+        error_ = config_.mode == Mode::Loopback
+            ? "Mode::Loopback puts probes on the bus; set allow_bus_loopback to use it"
+            : "probe mode is not a loopback mode";
+        return sweeps;
+    }
+
+    const int original_baudrate = device_.baudrate();
+    const Speed original_speed = device_.speed();
+    const Mode original_mode = device_.mode();
+    auto restore = [&]() {
+        device_.set_baudrate(original_baudrate);
+        device_.set_speed(original_speed);
+        device_.set_mode(original_mode);
+        while (device_.recv_frame()) {}
+    };
+
+    // Without an echo the sweep would only measure its own timeouts.
+    if (!device_.set_mode(config_.mode)) {
+        error_ = "could not send the loopback settings";
+        restore();
+        return sweeps;
+    }
+    if (!device_.echo_probe(static_cast<int>(config_.echo_timeout.count()))) {
+        error_ = "adapter did not echo a probe in loopback mode";
+        restore();
+        return sweeps;
+    }
+
+    std::vector<int> baudrates = config_.baudrates;
+    if (baudrates.empty()) baudrates.push_back(original_baudrate);
+    std::vector<Speed> speeds = config_.speeds;
+    if (speeds.empty()) speeds.push_back(original_speed);
+
+    for (int baudrate : baudrates) {
+        bool port_set = device_.set_baudrate(baudrate);
+        for (Speed speed : speeds) {
+            // Resends the settings, loopback mode included, at the new
+            // baudrate; only an echo shows the adapter is listening there.
+            bool answered = port_set && device_.set_speed(speed) &&
+                            device_.echo_probe(static_cast<int>(config_.echo_timeout.count()));
+            for (size_t dlc : config_.dlcs) {
+                if (answered) {
+                    sweeps.push_back(sweep(dlc));
+                    continue;
+                }
+                ProbeSweep skipped;
+                skipped.baudrate = baudrate;
+                skipped.speed = speed;
+                skipped.dlc = dlc;
+                skipped.capacity_fps = link_capacity_fps(baudrate, speed, dlc);
+                skipped.answered = false;
+                sweeps.push_back(skipped);
+            }
+        }
+    }
+
+    restore();
+    return sweeps;
+}
+
+const std::string& LoopbackProbe::error() const {
+    return error_;
+}
+
+std::string format_sweep(const ProbeSweep& sweep) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(0)
+        << "Loopback probe: " << sweep.baudrate << " baud, " << speed_to_bitrate(sweep.speed)
+        << " bit/s, DLC " << sweep.dlc << " (link capacity " << sweep.capacity_fps << " frames/s)\n";
+    if (!sweep.answered) {
+        oss << "  no echo at this baudrate; skipped";
+        return oss.str();
+    }
+    oss << "  offered     sent  achieved   lost    min us    p50 us    p99 us    max us  growth\n";
+    for (const auto& step : sweep.steps) {
+        oss << std::setprecision(0)
+            << std::setw(9) << step.offered_fps << std::setw(9) << step.sent_fps
+            << std::setw(10) << step.achieved_fps << std::setw(7) << step.lost()
+            << std::setprecision(1)
+            << std::setw(10) << step.rtt.min_us << std::setw(10) << step.rtt.p50_us
+            << std::setw(10) << step.rtt.p99_us << std::setw(10) << step.rtt.max_us
+            << std::setw(7) << step.rtt_growth << "x"
+            << (step.sustained ? "" : "  !") << "\n";
+    }
+    oss << std::setprecision(0) << "  max sustainable: ";
+    if (sweep.max_sustainable_fps > 0) oss << sweep.max_sustainable_fps << " frames/s";
+    else oss << "none";
+    oss << ", knee: ";
+    if (sweep.knee_fps > 0) oss << sweep.knee_fps << " frames/s";
+    else oss << "not reached";
+    return oss.str();
+}
+
+} // namespace can_usb
@@ -1,7 +1,22 @@
 #include "can_usb_interface.hpp"
+#include "loopback_probe.hpp"
+#include "termios2_fallback.hpp"
 #include <gtest/gtest.h>
+#include <linux/can.h>
 #include <vector>
 #include <span>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdlib.h>
 
 using namespace can_usb;
 
@@ -39,6 +54,50 @@ TEST(CanUsbDeviceTest, FrameCompletionDetection_DataFrameWithDLC3) {
     EXPECT_TRUE(CanUsbDevice::is_complete(frame));
 }
 
+TEST(CanUsbDeviceTest, FrameCompletionDetection_ExtendedFrame) {
+    std::vector<uint8_t> frame = {
+        0xAA, 0xE2,             // info byte (extended, DLC=2)
+        0x00, 0xF1, 0xFE, 0x18, // ID 0x18FEF100
+        0x01, 0x02
+    };
+    EXPECT_FALSE(CanUsbDevice::is_complete(frame));
+    frame.push_back(0x55);
+    EXPECT_TRUE(CanUsbDevice::is_complete(frame));
+}
+
+TEST(CanUsbDeviceTest, DecodeStandardAndExtendedFrames) {
+    std::vector<uint8_t> std_frame = {0xAA, 0xC2, 0x23, 0x01, 0xDE, 0xAD, 0x55};
+    auto decoded = CanUsbDevice::decode_data_frame(std_frame);
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->can_id, 0x123u);
+    ASSERT_EQ(decoded->data.size(), 2u);
+    EXPECT_EQ(decoded->data[1], 0xAD);
+
+    std::vector<uint8_t> ext_frame = {0xAA, 0xE1, 0x00, 0xF1, 0xFE, 0x18, 0x42, 0x55};
+    decoded = CanUsbDevice::decode_data_frame(ext_frame);
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->can_id, 0x18FEF100u | CAN_EFF_FLAG);
+    ASSERT_EQ(decoded->data.size(), 1u);
+    EXPECT_EQ(decoded->data[0], 0x42);
+
+    std::vector<uint8_t> settings(20, 0x00);
+    settings[0] = 0xAA;
+    settings[1] = 0x55;
+    EXPECT_FALSE(CanUsbDevice::decode_data_frame(settings).has_value());
+}
+
+TEST(CanUsbDeviceTest, WireSizeMatchesFraming) {
+    EXPECT_EQ(CanUsbDevice::wire_size(FrameType::Standard, 8), 13u);
+    EXPECT_EQ(CanUsbDevice::wire_size(FrameType::Extended, 8), 15u);
+    EXPECT_EQ(CanUsbDevice::wire_size(FrameType::Standard, 0), 5u);
+}
+
+TEST(CanUsbDeviceTest, SpeedToBitrate) {
+    EXPECT_EQ(speed_to_bitrate(Speed::S1000000), 1000000u);
+    EXPECT_EQ(speed_to_bitrate(Speed::S125000), 125000u);
+    EXPECT_EQ(speed_to_bitrate(Speed::S5000), 5000u);
+}
+
 TEST(CanUsbDeviceTest, SendDataFrameBuildsCorrectLength) {
     CanUsbDevice dev("/dev/null", 2000000, Speed::S500000, false);
     std::vector<uint8_t> payload = {0xDE, 0xAD, 0xBE, 0xEF};
@@ -48,3 +107,756 @@ TEST(CanUsbDeviceTest, SendDataFrameBuildsCorrectLength) {
     bool result = dev.send_data(FrameType::Standard, 0x123, payload);
     EXPECT_FALSE(result); // because /dev/null doesn't respond
 }
+
+// Stands in for the USB adapter: a pty whose slave side is reachable through a
+// symlink, the way udev exposes adapters under /dev/serial/by-path.
+class PtyAdapter {
+public:
+    explicit PtyAdapter(const std::string& link) : link_(link) { plug(); }
+    ~PtyAdapter() { unplug(); }
+
+    void plug() {
+        master_ = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        grantpt(master_);
+        unlockpt(master_);
+        symlink(ptsname(master_), link_.c_str());
+    }
+
+    void unplug() {
+        if (master_ != -1) {
+            ::unlink(link_.c_str());
+            ::close(master_);
+            master_ = -1;
+        }
+    }
+
+    void write(const std::vector<uint8_t>& bytes) {
+        ASSERT_EQ(::write(master_, bytes.data(), bytes.size()), static_cast<ssize_t>(bytes.size()));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    std::vector<uint8_t> read_all(int timeout_ms) {
+        std::vector<uint8_t> out;
+        struct pollfd pfd = { master_, POLLIN, 0 };
+        while (poll(&pfd, 1, timeout_ms) > 0) {
+            uint8_t buf[256];
+            ssize_t n = ::read(master_, buf, sizeof(buf));
+            if (n <= 0) break;
+            out.insert(out.end(), buf, buf + n);
+            timeout_ms = 20;
+        }
+        return out;
+    }
+
+    int master() const { return master_; }
+
+private:
+    std::string link_;
+    int master_ = -1;
+};
+
+// A pty adapter that behaves like the firmware: it applies settings frames
+// with a valid checksum and, in a loopback mode, echoes data frames back. It
+// only understands the host when the port is set to its own baudrate (the
+// pty master reports the slave's termios); at any other rate the bytes are
+// treated as line noise. A baudrate of 0 accepts any rate.
+//
+// With `bus_timing` each echo waits for the frame's nominal time on the bus
+// at the configured speed, and frames beyond a small transmit queue are
+// dropped, so offered load past the bus capacity shows up as queueing and
+// loss the way it does on a real controller.
+class SimulatedAdapter {
+public:
+    SimulatedAdapter(const std::string& link, int baudrate, bool bus_timing = false)
+        : pty_(link), baudrate_(baudrate), bus_timing_(bus_timing), thread_([this]() { run(); }) {}
+
+    ~SimulatedAdapter() {
+        running_ = false;
+        thread_.join();
+    }
+
+    Mode mode() const { return mode_; }
+    Speed speed() const { return speed_; }
+    int settings_received() const { return settings_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t kTxQueue = 32;
+
+    struct Echo {
+        Clock::time_point due;
+        std::vector<uint8_t> bytes;
+    };
+
+    PtyAdapter pty_;
+    int baudrate_;
+    bool bus_timing_;
+    std::atomic<bool> running_ = true;
+    std::atomic<Mode> mode_ = Mode::Normal;
+    std::atomic<Speed> speed_ = Speed::S500000;
+    std::atomic<int> settings_ = 0;
+    std::vector<uint8_t> rx_;
+    std::deque<Echo> tx_;
+    Clock::time_point bus_free_;
+    std::thread thread_;
+
+    bool host_baud_matches() {
+        if (baudrate_ == 0) return true;
+        struct termios2 tio;
+        return ioctl(pty_.master(), TCGETS2, &tio) == 0 &&
+               tio.c_ospeed == static_cast<unsigned>(baudrate_);
+    }
+
+    void run() {
+        while (running_) {
+            auto wait = std::chrono::nanoseconds(std::chrono::milliseconds(5));
+            if (!tx_.empty()) wait = std::max(std::chrono::nanoseconds(0), std::min(wait, tx_.front().due - Clock::now()));
+            struct timespec ts = { 0, static_cast<long>(wait.count()) };
+            struct pollfd pfd = { pty_.master(), POLLIN, 0 };
+            if (ppoll(&pfd, 1, &ts, nullptr) > 0) {
+                uint8_t buf[256];
+                ssize_t n = ::read(pty_.master(), buf, sizeof(buf));
+                if (n > 0 && host_baud_matches()) {
+                    rx_.insert(rx_.end(), buf, buf + n);
+                    parse();
+                }
+            }
+            while (!tx_.empty() && tx_.front().due <= Clock::now()) {
+                echo(tx_.front().bytes);
+                tx_.pop_front();
+            }
+        }
+    }
+
+    void echo(const std::vector<uint8_t>& bytes) {
+        ASSERT_EQ(::write(pty_.master(), bytes.data(), bytes.size()), static_cast<ssize_t>(bytes.size()));
+    }
+
+    void transmit(std::vector<uint8_t> bytes, size_t dlc) {
+        if (!bus_timing_) {
+            echo(bytes);
+            return;
+        }
+        if (tx_.size() >= kTxQueue) return;
+        auto bits = 47 + 8 * dlc;
+        auto on_bus = std::chrono::nanoseconds(bits * 1000000000ull / speed_to_bitrate(speed_));
+        bus_free_ = std::max(bus_free_, Clock::now()) + on_bus;
+        tx_.push_back({bus_free_, std::move(bytes)});
+    }
+
+    void parse() {
+        while (!rx_.empty()) {
+            if (rx_[0] != 0xAA) {
+                rx_.erase(rx_.begin());
+                continue;
+            }
+            if (!CanUsbDevice::is_complete(rx_)) return;
+
+            uint8_t info = rx_[1];
+            size_t len = 1;
+            if (info == 0x55) {
+                len = 20;
+                if (CanUsbDevice::checksum({rx_.begin() + 2, rx_.begin() + 19}) == rx_[19]) {
+                    speed_ = static_cast<Speed>(rx_[3]);
+                    mode_ = static_cast<Mode>(rx_[13]);
+                    ++settings_;
+                }
+            } else if ((info & 0xC0) == 0xC0 && (info & 0x0F) <= 8) {
+                auto type = (info & 0x20) ? FrameType::Extended : FrameType::Standard;
+                len = CanUsbDevice::wire_size(type, info & 0x0F);
+                bool loopback = mode_ == Mode::Loopback || mode_ == Mode::LoopbackSilent;
+                if (loopback && rx_[len - 1] == 0x55) {
+                    transmit({rx_.begin(), rx_.begin() + len}, info & 0x0F);
+                }
+            }
+            rx_.erase(rx_.begin(), rx_.begin() + len);
+        }
+    }
+};
+
+TEST(CanUsbDeviceTest, ClosedDeviceDoesNotQueue) {
+    CanUsbDevice dev("/dev/null", 2000000, Speed::S500000, false);
+    EXPECT_FALSE(dev.is_connected());
+    EXPECT_FALSE(dev.reconnect(0));
+    std::vector<uint8_t> payload = {0x01};
+    EXPECT_FALSE(dev.send_data(FrameType::Standard, 0x100, payload));
+    EXPECT_EQ(dev.pending_frames(), 0u);
+}
+
+TEST(CanUsbDeviceTest, RecoversAfterHotplugAndFlushesQueue) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    PtyAdapter adapter(link);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    dev.set_reconnect_timeout(20);
+    ASSERT_TRUE(dev.open());
+    ASSERT_TRUE(dev.init());
+
+    auto settings = adapter.read_all(200);
+    ASSERT_EQ(settings.size(), 20u);
+    EXPECT_EQ(settings[0], 0xAA);
+    EXPECT_EQ(settings[1], 0x55);
+    EXPECT_EQ(settings[19], CanUsbDevice::checksum({settings.begin() + 2, settings.begin() + 19}));
+
+    adapter.unplug();
+    EXPECT_FALSE(dev.recv_frame().has_value());
+    EXPECT_FALSE(dev.is_connected());
+
+    std::vector<uint8_t> payload = {0xDE, 0xAD};
+    EXPECT_TRUE(dev.send_data(FrameType::Standard, 0x123, payload));
+    EXPECT_EQ(dev.pending_frames(), 1u);
+
+    std::thread replug([&adapter]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        adapter.plug();
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    while (!dev.is_connected() && std::chrono::steady_clock::now() - start < std::chrono::seconds(2)) {
+        dev.recv_frame();
+    }
+    replug.join();
+
+    ASSERT_TRUE(dev.is_connected());
+    EXPECT_EQ(dev.reconnect_count(), 1u);
+    EXPECT_EQ(dev.pending_frames(), 0u);
+
+    // The settings frame is replayed first, then the frame queued while unplugged.
+    auto replayed = adapter.read_all(200);
+    ASSERT_GE(replayed.size(), settings.size() + 7);
+    EXPECT_TRUE(std::equal(settings.begin(), settings.end(), replayed.begin()));
+    std::vector<uint8_t> expected_data = {0xAA, 0xC2, 0x23, 0x01, 0xDE, 0xAD, 0x55};
+    EXPECT_TRUE(std::equal(expected_data.begin(), expected_data.end(),
+                           replayed.end() - expected_data.size()));
+
+    dev.close();
+    adapter.unplug();
+    rmdir(dir_template);
+}
+
+TEST(CanUsbDeviceTest, IdleLinkStaysConnected) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    PtyAdapter adapter(link);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+
+    // The port is put in blocking-read semantics whatever it had before.
+    struct termios2 tio;
+    ASSERT_EQ(ioctl(adapter.master(), TCGETS2, &tio), 0);
+    EXPECT_EQ(tio.c_cc[VMIN], 1);
+    EXPECT_EQ(tio.c_cc[VTIME], 0);
+
+    for (int i = 0; i < 20; ++i) EXPECT_FALSE(dev.recv_frame().has_value());
+    EXPECT_TRUE(dev.is_connected());
+    EXPECT_EQ(dev.reconnect_count(), 0u);
+
+    dev.close();
+    adapter.unplug();
+    rmdir(dir_template);
+}
+
+// Splits a byte stream into the frames the adapter's parser would see,
+// failing the test on anything that is not a whole frame.
+std::vector<std::vector<uint8_t>> split_frames(const std::vector<uint8_t>& wire) {
+    std::vector<std::vector<uint8_t>> frames;
+    size_t off = 0;
+    while (off < wire.size()) {
+        std::vector<uint8_t> rest(wire.begin() + off, wire.end());
+        EXPECT_EQ(rest[0], 0xAA) << "at byte " << off;
+        if (rest[0] != 0xAA || !CanUsbDevice::is_complete(rest)) {
+            ADD_FAILURE() << "truncated frame at byte " << off;
+            break;
+        }
+        size_t len = rest[1] == 0x55 ? 20 : CanUsbDevice::wire_size(
+            (rest[1] & 0x20) ? FrameType::Extended : FrameType::Standard, rest[1] & 0x0F);
+        frames.emplace_back(rest.begin(), rest.begin() + len);
+        off += len;
+    }
+    return frames;
+}
+
+TEST(CanUsbDeviceTest, StalledWriteNeverLeavesATruncatedFrame) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    // Nobody reads the master, so the tty output buffer eventually fills
+    // and a frame is cut short.
+    PtyAdapter adapter(link);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+    ASSERT_TRUE(dev.init());
+
+    std::vector<uint8_t> payload = {1, 2, 3, 4, 5, 6, 7, 8};
+    const size_t frame_size = CanUsbDevice::wire_size(FrameType::Standard, payload.size());
+    size_t sent = 0;
+    while (dev.send_data(FrameType::Standard, 0x123, payload)) ++sent;
+    ASSERT_GT(sent, 0u);
+    EXPECT_TRUE(dev.is_connected());
+
+    // Once the adapter drains its input, the next write first finishes the
+    // cut frame, so the settings that follow parse as settings.
+    auto wire = adapter.read_all(50);
+    ASSERT_TRUE(dev.set_speed(Speed::S250000));
+    auto more = adapter.read_all(50);
+    wire.insert(wire.end(), more.begin(), more.end());
+
+    const size_t settings_size = 20;
+    EXPECT_EQ((wire.size() - settings_size) % frame_size, settings_size % frame_size);
+    auto frames = split_frames(wire);
+    ASSERT_GE(frames.size(), 3u);
+    EXPECT_EQ(frames.front().size(), settings_size);
+    const auto& replayed = frames.back();
+    ASSERT_EQ(replayed.size(), settings_size);
+    EXPECT_EQ(replayed[1], 0x55);
+    EXPECT_EQ(replayed[3], static_cast<uint8_t>(Speed::S250000));
+    EXPECT_EQ(replayed[19], CanUsbDevice::checksum({replayed.begin() + 2, replayed.begin() + 19}));
+    for (size_t i = 1; i + 1 < frames.size(); ++i) EXPECT_EQ(frames[i].size(), frame_size);
+
+    dev.close();
+    adapter.unplug();
+    rmdir(dir_template);
+}
+
+TEST(CanUsbDeviceTest, FrameCutByUnplugIsResentWholeAfterSettings) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    PtyAdapter adapter(link);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    dev.set_reconnect_timeout(20);
+    ASSERT_TRUE(dev.open());
+    ASSERT_TRUE(dev.init());
+
+    std::vector<uint8_t> payload = {1, 2, 3, 4, 5, 6, 7, 8};
+    while (dev.send_data(FrameType::Standard, 0x123, payload)) {}
+
+    // The replacement adapter's parser starts clean: the cut frame is sent
+    // again in full after the settings, never as a dangling tail.
+    adapter.unplug();
+    EXPECT_FALSE(dev.recv_frame().has_value());
+    ASSERT_FALSE(dev.is_connected());
+    adapter.plug();
+    auto start = std::chrono::steady_clock::now();
+    while (!dev.is_connected() && std::chrono::steady_clock::now() - start < std::chrono::seconds(2)) {
+        dev.recv_frame();
+    }
+    ASSERT_TRUE(dev.is_connected());
+
+    auto frames = split_frames(adapter.read_all(200));
+    ASSERT_EQ(frames.size(), 2u);
+    EXPECT_EQ(frames[0].size(), 20u);
+    EXPECT_EQ(frames[1].size(), CanUsbDevice::wire_size(FrameType::Standard, payload.size()));
+
+    dev.close();
+    adapter.unplug();
+    rmdir(dir_template);
+}
+
+TEST(CanUsbDeviceTest, QueueIsBounded) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    PtyAdapter adapter(link);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    dev.set_reconnect_timeout(0);
+    dev.set_queue_limit(2);
+    ASSERT_TRUE(dev.open());
+
+    adapter.unplug();
+    dev.recv_frame();
+    ASSERT_FALSE(dev.is_connected());
+
+    std::vector<uint8_t> payload = {0x01};
+    EXPECT_TRUE(dev.send_data(FrameType::Standard, 0x1, payload));
+    EXPECT_TRUE(dev.send_data(FrameType::Standard, 0x2, payload));
+    EXPECT_FALSE(dev.send_data(FrameType::Standard, 0x3, payload));
+    EXPECT_EQ(dev.pending_frames(), 2u);
+    EXPECT_EQ(dev.dropped_frames(), 1u);
+
+    dev.close();
+    rmdir(dir_template);
+}
+
+TEST(CanUsbDeviceTest, ParserReassemblesSplitFramesAndCountsDiscards) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    PtyAdapter adapter(link);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+
+    // Line noise, then a frame that arrives in two reads.
+    adapter.write({0x00, 0x13, 0xAA, 0xC2, 0x23});
+    EXPECT_FALSE(dev.recv_frame().has_value());
+    adapter.write({0x01, 0xDE, 0xAD, 0x55});
+    auto frame = dev.recv_frame();
+    ASSERT_TRUE(frame.has_value());
+    EXPECT_EQ(*frame, (std::vector<uint8_t>{0xAA, 0xC2, 0x23, 0x01, 0xDE, 0xAD, 0x55}));
+
+    // A frame with a corrupted stop byte is skipped; the next one still parses.
+    adapter.write({0xAA, 0xC1, 0x01, 0x00, 0x77, 0x00, 0xAA, 0xC1, 0x02, 0x00, 0x88, 0x55});
+    frame = dev.recv_frame();
+    ASSERT_TRUE(frame.has_value());
+    EXPECT_EQ((*frame)[2], 0x02);
+
+    // A settings/status frame with a bad checksum.
+    std::vector<uint8_t> status(20, 0x00);
+    status[0] = 0xAA;
+    status[1] = 0x55;
+    status[2] = 0x12;
+    status[19] = 0x99;
+    adapter.write(status);
+    EXPECT_FALSE(dev.recv_frame().has_value());
+
+    LinkCounters counters = dev.link_counters();
+    EXPECT_EQ(counters.frames, 2u);
+    EXPECT_EQ(counters.stop_byte_errors, 1u);
+    EXPECT_EQ(counters.checksum_errors, 1u);
+    EXPECT_EQ(counters.discarded(), 2u);
+    EXPECT_GE(counters.resync_bytes, 2u);
+    EXPECT_EQ(counters.tty_errors(), 0u);  // ptys do not implement TIOCGICOUNT
+
+    dev.close();
+    adapter.unplug();
+    rmdir(dir_template);
+}
+
+TEST(CanUsbDeviceTest, ExtendedIdRoundTripsOverSerial) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    PtyAdapter adapter(link);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+
+    std::vector<uint8_t> payload = {0x11, 0x22, 0x33};
+    ASSERT_TRUE(dev.send_can_frame(0x18DAF110 | CAN_EFF_FLAG, payload));
+    auto sent = adapter.read_all(200);
+    EXPECT_EQ(sent, (std::vector<uint8_t>{0xAA, 0xE3, 0x10, 0xF1, 0xDA, 0x18, 0x11, 0x22, 0x33, 0x55}));
+
+    // Echo it back as if the adapter had received it from the bus.
+    adapter.write(sent);
+    auto frame = dev.recv_frame();
+    ASSERT_TRUE(frame.has_value());
+    auto decoded = CanUsbDevice::decode_data_frame(*frame);
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->can_id, 0x18DAF110u | CAN_EFF_FLAG);
+    EXPECT_TRUE(std::equal(payload.begin(), payload.end(), decoded->data.begin()));
+
+    dev.close();
+    adapter.unplug();
+    rmdir(dir_template);
+}
+
+TEST(CanUsbDeviceTest, VerifyConfirmsAdapterAndRestoresNormalMode) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    SimulatedAdapter adapter(link, 2000000);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+
+    EXPECT_TRUE(dev.verify(500));
+    EXPECT_EQ(adapter.settings_received(), 2);  // loopback-silent, then normal
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(adapter.mode(), Mode::Normal);
+
+    dev.close();
+    rmdir(dir_template);
+}
+
+TEST(CanUsbDeviceTest, VerifyTimesOutWhenAdapterIsSilent) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    PtyAdapter adapter(link);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(dev.verify(50));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(50));
+    EXPECT_LT(elapsed, std::chrono::milliseconds(500));
+
+    dev.close();
+    adapter.unplug();
+    rmdir(dir_template);
+}
+
+TEST(CanUsbDeviceTest, DetectsBaudrate) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    SimulatedAdapter adapter(link, 115200);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+
+    const int candidates[] = {2000000, 1000000, 115200, 9600};
+    auto rate = dev.detect_baudrate(candidates, 100);
+    ASSERT_TRUE(rate.has_value());
+    EXPECT_EQ(*rate, 115200);
+    EXPECT_EQ(dev.baudrate(), 115200);
+
+    // No candidate answers: the original rate is kept.
+    const int wrong[] = {9600, 19200};
+    EXPECT_FALSE(dev.detect_baudrate(wrong, 30).has_value());
+    EXPECT_EQ(dev.baudrate(), 115200);
+
+    dev.close();
+    rmdir(dir_template);
+}
+
+TEST(CanUsbDeviceTest, SettingsFollowSpeedAndMode) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    SimulatedAdapter adapter(link, 2000000);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+
+    // Nothing is sent before init(); the values are only stored.
+    EXPECT_TRUE(dev.set_mode(Mode::Loopback));
+    ASSERT_TRUE(dev.init());
+    EXPECT_TRUE(dev.set_speed(Speed::S125000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(adapter.settings_received(), 2);
+    EXPECT_EQ(adapter.mode(), Mode::Loopback);
+    EXPECT_EQ(adapter.speed(), Speed::S125000);
+
+    // verify() puts back the configured mode, not necessarily Normal.
+    EXPECT_TRUE(dev.verify(500));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(adapter.mode(), Mode::Loopback);
+
+    dev.close();
+    rmdir(dir_template);
+}
+
+TEST(CanUsbDeviceTest, SettingsChangeWhileReceiving) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    SimulatedAdapter adapter(link, 2000000);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+    ASSERT_TRUE(dev.init());
+
+    // The receiving thread keeps reading (and would reconnect) while
+    // another thread changes the settings.
+    std::atomic<bool> done = false;
+    std::thread receiver([&]() {
+        while (!done) {
+            if (!dev.recv_frame()) std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+    for (int i = 0; i < 50; ++i) {
+        EXPECT_TRUE(dev.set_mode(i % 2 ? Mode::LoopbackSilent : Mode::Silent));
+        EXPECT_TRUE(dev.set_speed(i % 2 ? Speed::S250000 : Speed::S125000));
+    }
+    done = true;
+    receiver.join();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(adapter.settings_received(), 101);
+    EXPECT_EQ(adapter.mode(), Mode::LoopbackSilent);
+    EXPECT_EQ(adapter.speed(), Speed::S250000);
+
+    dev.close();
+    rmdir(dir_template);
+}
+
+TEST(LoopbackProbeTest, LinkCapacity) {
+    // 8 data bytes: 111 bus bits plus up to 24 stuff bits, 13 serial bytes.
+    EXPECT_NEAR(LoopbackProbe::link_capacity_fps(2000000, Speed::S1000000, 8), 1000000.0 / 135, 1);
+    EXPECT_NEAR(LoopbackProbe::link_capacity_fps(115200, Speed::S1000000, 8), 115200.0 / 130, 1);
+    // No data: 47 bits plus up to 8 stuff bits.
+    EXPECT_NEAR(LoopbackProbe::link_capacity_fps(2000000, Speed::S125000, 0), 125000.0 / 55, 1);
+}
+
+TEST(LoopbackProbeTest, SweepsEveryBaudrateAndSpeed) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    SimulatedAdapter adapter(link, 0);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+    ASSERT_TRUE(dev.init());
+
+    ProbeConfig config;
+    config.baudrates = {115200, 2000000};
+    config.speeds = {Speed::S1000000, Speed::S250000};
+    config.dlcs = {0, 8};
+    config.rates = {200};
+    config.min_frames = 20;
+    config.step_duration = std::chrono::milliseconds(50);
+    auto sweeps = LoopbackProbe(dev, config).run();
+
+    ASSERT_EQ(sweeps.size(), 8u);
+    EXPECT_EQ(sweeps[0].baudrate, 115200);
+    EXPECT_EQ(sweeps[0].speed, Speed::S1000000);
+    EXPECT_EQ(sweeps[3].speed, Speed::S250000);
+    EXPECT_EQ(sweeps[3].dlc, 8u);
+    EXPECT_EQ(sweeps[7].baudrate, 2000000);
+    for (const auto& sweep : sweeps) {
+        EXPECT_TRUE(sweep.answered);
+        ASSERT_EQ(sweep.steps.size(), 1u);
+        const auto& step = sweep.steps[0];
+        EXPECT_EQ(step.sent, 20u);
+        EXPECT_EQ(step.received, step.sent);
+        EXPECT_EQ(step.rtt.samples, step.sent);
+        EXPECT_LE(step.rtt.min_us, step.rtt.p50_us);
+        EXPECT_LE(step.rtt.p99_us, step.rtt.max_us);
+    }
+
+    // The device is left as it was found.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(dev.baudrate(), 2000000);
+    EXPECT_EQ(dev.speed(), Speed::S500000);
+    EXPECT_EQ(adapter.mode(), Mode::Normal);
+    EXPECT_EQ(adapter.speed(), Speed::S500000);
+
+    dev.close();
+    rmdir(dir_template);
+}
+
+TEST(LoopbackProbeTest, SkipsBaudratesTheAdapterDoesNotAnswer) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    // Like a real adapter, this one's UART only runs at 2000000 baud.
+    SimulatedAdapter adapter(link, 2000000);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+    ASSERT_TRUE(dev.init());
+
+    ProbeConfig config;
+    config.baudrates = {115200, 2000000};
+    config.dlcs = {8};
+    config.rates = {200};
+    config.min_frames = 20;
+    config.step_duration = std::chrono::milliseconds(50);
+    config.echo_timeout = std::chrono::milliseconds(30);
+    auto sweeps = LoopbackProbe(dev, config).run();
+
+    ASSERT_EQ(sweeps.size(), 2u);
+    EXPECT_EQ(sweeps[0].baudrate, 115200);
+    EXPECT_FALSE(sweeps[0].answered);
+    EXPECT_TRUE(sweeps[0].steps.empty());
+    EXPECT_NE(format_sweep(sweeps[0]).find("no echo"), std::string::npos);
+
+    EXPECT_EQ(sweeps[1].baudrate, 2000000);
+    EXPECT_TRUE(sweeps[1].answered);
+    ASSERT_EQ(sweeps[1].steps.size(), 1u);
+    EXPECT_EQ(sweeps[1].steps[0].received, sweeps[1].steps[0].sent);
+    EXPECT_EQ(dev.baudrate(), 2000000);
+
+    dev.close();
+    rmdir(dir_template);
+}
+
+TEST(LoopbackProbeTest, RefusesUnlessLoopbackIsConfirmed) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    ProbeConfig config;
+    config.dlcs = {0};
+    config.rates = {200};
+    config.min_frames = 10;
+    config.step_duration = std::chrono::milliseconds(20);
+    config.echo_timeout = std::chrono::milliseconds(30);
+
+    {
+        // An adapter that never echoes: nothing is swept, and its mode is put back.
+        PtyAdapter silent(link);
+        CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+        ASSERT_TRUE(dev.open());
+
+        LoopbackProbe uninitialized(dev, config);
+        EXPECT_TRUE(uninitialized.run().empty());
+        EXPECT_FALSE(uninitialized.error().empty());
+
+        ASSERT_TRUE(dev.init());
+        LoopbackProbe unanswered(dev, config);
+        EXPECT_TRUE(unanswered.run().empty());
+        EXPECT_NE(unanswered.error().find("echo"), std::string::npos);
+        EXPECT_EQ(dev.mode(), Mode::Normal);
+
+        dev.close();
+        silent.unplug();
+    }
+
+    SimulatedAdapter adapter(link, 2000000);
+    CanUsbDevice dev(link, 2000000, Speed::S500000, false);
+    ASSERT_TRUE(dev.open());
+    ASSERT_TRUE(dev.init());
+
+    // Loopback (not silent) would put the probes on the bus: opt-in only.
+    config.mode = Mode::Loopback;
+    LoopbackProbe on_bus(dev, config);
+    EXPECT_TRUE(on_bus.run().empty());
+    EXPECT_EQ(adapter.settings_received(), 1);
+
+    config.allow_bus_loopback = true;
+    LoopbackProbe opted_in(dev, config);
+    auto sweeps = opted_in.run();
+    ASSERT_EQ(sweeps.size(), 1u);
+    EXPECT_TRUE(opted_in.error().empty());
+    EXPECT_EQ(sweeps[0].steps[0].received, sweeps[0].steps[0].sent);
+
+    dev.close();
+    rmdir(dir_template);
+}
+
+TEST(LoopbackProbeTest, FindsBusThroughputKnee) {
+    char dir_template[] = "/tmp/can_usb_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string link = std::string(dir_template) + "/ttyCAN";
+
+    // 125 kbit/s carries 926 to 1126 eight-byte frames/s, depending on stuffing.
+    SimulatedAdapter adapter(link, 2000000, true);
+    CanUsbDevice dev(link, 2000000, Speed::S125000, false);
+    ASSERT_TRUE(dev.open());
+    ASSERT_TRUE(dev.init());
+
+    ProbeConfig config;
+    config.dlcs = {8};
+    config.rates = {250, 500, 2000, 4000};
+    config.step_duration = std::chrono::milliseconds(100);
+    auto sweeps = LoopbackProbe(dev, config).run();
+
+    ASSERT_EQ(sweeps.size(), 1u);
+    const auto& sweep = sweeps[0];
+    ASSERT_GE(sweep.steps.size(), 3u);
+    EXPECT_TRUE(sweep.steps[0].sustained);
+    // An echo cannot beat the frame's own time on the bus (888 us).
+    EXPECT_GE(sweep.steps[0].rtt.min_us, 888);
+    EXPECT_FALSE(sweep.steps[2].sustained);
+    EXPECT_GT(sweep.steps[2].lost(), 0u);
+
+    EXPECT_GE(sweep.max_sustainable_fps, 250);
+    EXPECT_LT(sweep.max_sustainable_fps, sweep.capacity_fps);
+    EXPECT_GT(sweep.knee_fps, sweep.max_sustainable_fps);
+    EXPECT_LE(sweep.knee_fps, 2000);
+
+    dev.close();
+    rmdir(dir_template);
+}
@@ -0,0 +1,89 @@
+// example/main.cpp — follows a bridge frame ring and prints every frame
+#include "shm_frame_ring.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <atomic>
+#include <cstring>
+
+std::atomic<bool> keep_running{true};
+
+void signal_handler(int) {
+    keep_running = false;
+}
+
+void print_usage() {
+    std::cout << "Usage: ring_dump [options]\n"
+              << "  -n, --name <name>    Shared-memory ring name (default: can_bridge)\n"
+              << "      --oldest         Start from the oldest frame still in the ring\n"
+              << "      --help           Show this help message\n";
+}
+
+int main(int argc, char* argv[]) {
+    using namespace shm_ring;
+
+    std::string name = "can_bridge";
+    bool from_oldest = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if ((std::strcmp(argv[i], "--name") == 0 || std::strcmp(argv[i], "-n") == 0) && i + 1 < argc) {
+            name = argv[++i];
+        } else if (std::strcmp(argv[i], "--oldest") == 0) {
+            from_oldest = true;
+        } else if (std::strcmp(argv[i], "--help") == 0) {
+            print_usage();
+            return 0;
+        }
+    }
+
+    FrameRingReader reader(name);
+    if (!reader.open()) {
+        std::cerr << "Failed to open frame ring " << name << std::endl;
+        return 1;
+    }
+    if (from_oldest) reader.seek_oldest();
+
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    uint64_t restarts = 0;
+    while (keep_running) {
+        const RingSlot* frame = nullptr;
+        ReadStatus status = reader.peek(frame);
+
+        if (reader.restarts() != restarts) {
+            restarts = reader.restarts();
+            std::cerr << "[restart] bridge reopened the ring (" << reader.capacity() << " slots)\n";
+        }
+
+        if (status == ReadStatus::Empty) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        if (status == ReadStatus::Overrun) {
+            std::cerr << "[overrun] lost " << reader.lost() << " frames so far\n";
+            continue;
+        }
+
+        std::ostringstream oss;
+        oss << std::dec << frame->timestamp_ns << ' '
+            << (frame->direction == Direction::UsbToHost ? "usb->host" : "host->usb")
+            << " ID=0x" << std::hex << std::uppercase << std::setw(3) << std::setfill('0')
+            << frame->can_id << " [" << std::dec << int(frame->len) << "] ";
+        for (size_t i = 0; i < frame->len && i < kMaxFrameData; ++i) {
+            oss << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
+                << static_cast<int>(frame->data[i]) << " ";
+        }
+
+        // Only print what survived the writer: a torn frame is counted as lost.
+        if (reader.advance() == ReadStatus::Ok) {
+            std::cout << oss.str() << '\n';
+        }
+    }
+
+    return 0;
+}
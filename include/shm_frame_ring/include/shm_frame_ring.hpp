@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <span>
+#include <mutex>
+#include <functional>
+
+#include "can_direction.hpp"
+
+namespace shm_ring {
+
+constexpr uint32_t kRingMagic = 0x43414E52; // "CANR"
+constexpr uint32_t kRingVersion = 2;
+constexpr size_t kMaxFrameData = 64;
+
+using Direction = can_common::Direction;
+
+enum class ReadStatus {
+    Ok,
+    Empty,
+    Overrun
+};
+
+// One frame as it lives in shared memory. `seq` is the sequence number of the
+// frame currently stored in the slot, or 0 while the writer is rewriting it.
+struct alignas(64) RingSlot {
+    std::atomic<uint64_t> seq;
+    uint64_t timestamp_ns;
+    uint32_t can_id;
+    uint8_t len;
+    Direction direction;
+    uint8_t reserved[2];
+    uint8_t data[kMaxFrameData];
+};
+
+struct alignas(64) RingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t slot_size;
+    // Bumped in a ring's header when a restarted writer replaces it, so that
+    // readers still mapping the old object know to move over.
+    std::atomic<uint32_t> generation;
+    alignas(64) std::atomic<uint64_t> write_seq;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory ring requires lock-free 64-bit atomics");
+
+// Publishes frames into /dev/shm/<name>. Only the writer ever blocks; readers
+// that fall more than `capacity` frames behind detect it through the sequence
+// numbers and skip ahead.
+class FrameRingWriter {
+public:
+    FrameRingWriter(std::string name, uint32_t capacity = 4096, bool debug = false,
+                    std::function<void(const std::string&)> logger = nullptr);
+    ~FrameRingWriter();
+
+    bool open();
+    void close();
+    bool unlink();
+
+    bool publish(Direction direction, uint32_t can_id, std::span<const uint8_t> data,
+                 uint64_t timestamp_ns = 0);
+
+    uint64_t published() const;
+    uint32_t capacity() const;
+    void set_debug(bool enable);
+    bool is_debug() const;
+
+    static uint64_t now_ns();
+
+private:
+    std::string name_;
+    uint32_t capacity_;
+    uint64_t mask_;
+    bool debug_;
+    std::function<void(const std::string&)> logger_;
+
+    RingHeader* header_ = nullptr;
+    RingSlot* slots_ = nullptr;
+    size_t map_size_ = 0;
+
+    // The bridge publishes from both forwarding threads; they take turns here.
+    std::mutex publish_mutex_;
+
+    void log(const std::string& msg) const;
+};
+
+// Follows a ring created by FrameRingWriter. peek() hands out a pointer into
+// the shared mapping; advance() then confirms the writer did not overwrite the
+// slot while it was being looked at. When the writer restarts, the reader
+// drains the old ring and then reattaches to the new one on its own.
+class FrameRingReader {
+public:
+    explicit FrameRingReader(std::string name);
+    ~FrameRingReader();
+
+    bool open();
+    void close();
+
+    ReadStatus peek(const RingSlot*& frame);
+    ReadStatus advance();
+
+    void seek_latest();
+    void seek_oldest();
+
+    uint64_t next_sequence() const;
+    uint64_t lost() const;
+    uint64_t restarts() const;
+    uint32_t capacity() const;
+
+private:
+    std::string name_;
+    uint32_t capacity_ = 0;
+    uint64_t mask_ = 0;
+    uint64_t next_ = 1;
+    uint64_t lost_ = 0;
+    uint64_t restarts_ = 0;
+    uint32_t generation_ = 0;
+
+    const RingHeader* header_ = nullptr;
+    const RingSlot* slots_ = nullptr;
+    size_t map_size_ = 0;
+
+    bool attach();
+    bool follow_restart();
+    void resync(uint64_t write_seq);
+};
+
+} // namespace shm_ring
@@ -0,0 +1,321 @@
+#include "shm_frame_ring.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <iostream>
+#include <cstring>
+#include <new>
+
+namespace shm_ring {
+
+namespace {
+
+std::string shm_path(const std::string& name) {
+    return name.starts_with('/') ? name : "/" + name;
+}
+
+uint32_t round_up_pow2(uint32_t v) {
+    uint32_t p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+size_t ring_bytes(uint32_t capacity) {
+    return sizeof(RingHeader) + static_cast<size_t>(capacity) * sizeof(RingSlot);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// FrameRingWriter
+// ---------------------------------------------------------------------------
+
+FrameRingWriter::FrameRingWriter(std::string name, uint32_t capacity, bool debug,
+                                 std::function<void(const std::string&)> logger)
+    : name_(shm_path(name)), capacity_(round_up_pow2(capacity < 2 ? 2 : capacity)),
+      mask_(capacity_ - 1), debug_(debug), logger_(std::move(logger)) {}
+
+FrameRingWriter::~FrameRingWriter() { close(); }
+
+void FrameRingWriter::set_debug(bool enable) { debug_ = enable; }
+bool FrameRingWriter::is_debug() const { return debug_; }
+uint32_t FrameRingWriter::capacity() const { return capacity_; }
+
+void FrameRingWriter::log(const std::string& msg) const {
+    if (debug_) {
+        if (logger_) logger_(msg);
+        else std::cerr << msg << '\n';
+    }
+}
+
+uint64_t FrameRingWriter::now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+bool FrameRingWriter::open() {
+    // A ring left behind by an earlier bridge is never reused in place:
+    // readers may still map it, and shrinking it under them would fault. It is
+    // unlinked instead, a fresh object takes its name, and only then is the old
+    // header's generation bumped so those readers move over.
+    RingHeader* previous = nullptr;
+    size_t previous_size = 0;
+    uint32_t generation = 1;
+
+    int old_fd = shm_open(name_.c_str(), O_RDWR, 0);
+    if (old_fd >= 0) {
+        struct stat st;
+        if (fstat(old_fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(RingHeader)) {
+            void* mem = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, old_fd, 0);
+            if (mem != MAP_FAILED) {
+                previous = static_cast<RingHeader*>(mem);
+                previous_size = st.st_size;
+                if (previous->magic == kRingMagic && previous->version == kRingVersion) {
+                    generation = previous->generation.load(std::memory_order_relaxed) + 1;
+                }
+            }
+        }
+        ::close(old_fd);
+        shm_unlink(name_.c_str());
+    }
+
+    auto release_previous = [&](bool retire) {
+        if (!previous) return;
+        if (retire && previous->magic == kRingMagic && previous->version == kRingVersion) {
+            previous->generation.store(generation, std::memory_order_release);
+        }
+        munmap(previous, previous_size);
+    };
+
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        release_previous(false);
+        return false;
+    }
+
+    map_size_ = ring_bytes(capacity_);
+    if (ftruncate(fd, map_size_) < 0) {
+        perror("ftruncate");
+        ::close(fd);
+        release_previous(false);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        release_previous(false);
+        return false;
+    }
+
+    header_ = new (mem) RingHeader{};
+    slots_ = reinterpret_cast<RingSlot*>(static_cast<uint8_t*>(mem) + sizeof(RingHeader));
+    for (uint32_t i = 0; i < capacity_; ++i) {
+        new (&slots_[i]) RingSlot{};
+    }
+
+    header_->version = kRingVersion;
+    header_->capacity = capacity_;
+    header_->slot_size = sizeof(RingSlot);
+    header_->generation.store(generation, std::memory_order_relaxed);
+    header_->write_seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kRingMagic;
+
+    release_previous(true);
+
+    log("Frame ring " + name_ + " ready (" + std::to_string(capacity_) + " slots, generation " +
+        std::to_string(generation) + ")");
+    return true;
+}
+
+void FrameRingWriter::close() {
+    if (header_) {
+        munmap(header_, map_size_);
+        header_ = nullptr;
+        slots_ = nullptr;
+    }
+}
+
+bool FrameRingWriter::unlink() {
+    if (shm_unlink(name_.c_str()) < 0) {
+        perror("shm_unlink");
+        return false;
+    }
+    return true;
+}
+
+uint64_t FrameRingWriter::published() const {
+    return header_ ? header_->write_seq.load(std::memory_order_relaxed) : 0;
+}
+
+bool FrameRingWriter::publish(Direction direction, uint32_t can_id,
+                              std::span<const uint8_t> data, uint64_t timestamp_ns) {
+    if (!header_ || data.size() > kMaxFrameData) return false;
+    if (timestamp_ns == 0) timestamp_ns = now_ns();
+
+    std::lock_guard lock(publish_mutex_);
+
+    uint64_t seq = header_->write_seq.load(std::memory_order_relaxed) + 1;
+    RingSlot& slot = slots_[seq & mask_];
+
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.timestamp_ns = timestamp_ns;
+    slot.can_id = can_id;
+    slot.len = static_cast<uint8_t>(data.size());
+    slot.direction = direction;
+    std::memcpy(slot.data, data.data(), data.size());
+
+    slot.seq.store(seq, std::memory_order_release);
+    header_->write_seq.store(seq, std::memory_order_release);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// FrameRingReader
+// ---------------------------------------------------------------------------
+
+FrameRingReader::FrameRingReader(std::string name) : name_(shm_path(name)) {}
+
+FrameRingReader::~FrameRingReader() { close(); }
+
+uint64_t FrameRingReader::next_sequence() const { return next_; }
+uint64_t FrameRingReader::lost() const { return lost_; }
+uint64_t FrameRingReader::restarts() const { return restarts_; }
+uint32_t FrameRingReader::capacity() const { return capacity_; }
+
+bool FrameRingReader::open() {
+    if (!attach()) return false;
+    seek_latest();
+    return true;
+}
+
+// Maps whatever ring currently carries our name. The previous mapping, if
+// any, is only dropped once the new one checks out.
+bool FrameRingReader::attach() {
+    int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        if (!header_) perror("shm_open");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(RingHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    void* mem = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+
+    auto* header = static_cast<const RingHeader*>(mem);
+    if (header->magic != kRingMagic || header->version != kRingVersion ||
+        header->slot_size != sizeof(RingSlot) || size < ring_bytes(header->capacity)) {
+        munmap(mem, size);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    close();
+    header_ = header;
+    map_size_ = size;
+    generation_ = header_->generation.load(std::memory_order_relaxed);
+    capacity_ = header_->capacity;
+    mask_ = capacity_ - 1;
+    slots_ = reinterpret_cast<const RingSlot*>(static_cast<const uint8_t*>(mem) + sizeof(RingHeader));
+    return true;
+}
+
+// Called once the current ring has run dry. A restarted writer numbers its
+// frames from 1 again, so the new ring is read from its start.
+bool FrameRingReader::follow_restart() {
+    if (header_->generation.load(std::memory_order_acquire) == generation_) return false;
+    if (!attach()) return false;
+    ++restarts_;
+    next_ = 1;
+    return true;
+}
+
+void FrameRingReader::close() {
+    if (header_) {
+        munmap(const_cast<RingHeader*>(header_), map_size_);
+        header_ = nullptr;
+        slots_ = nullptr;
+    }
+}
+
+void FrameRingReader::seek_latest() {
+    if (header_) next_ = header_->write_seq.load(std::memory_order_acquire) + 1;
+}
+
+void FrameRingReader::seek_oldest() {
+    if (!header_) return;
+    uint64_t w = header_->write_seq.load(std::memory_order_acquire);
+    next_ = w >= capacity_ ? w - capacity_ + 1 : 1;
+}
+
+void FrameRingReader::resync(uint64_t write_seq) {
+    // Land a little ahead of the oldest surviving frame so the writer does not
+    // overwrite it again before we get there.
+    uint64_t target = write_seq >= capacity_ ? write_seq - capacity_ + 1 + capacity_ / 8 : 1;
+    if (target <= next_) target = next_ + 1;
+    lost_ += target - next_;
+    next_ = target;
+}
+
+ReadStatus FrameRingReader::peek(const RingSlot*& frame) {
+    if (!slots_) return ReadStatus::Empty;
+
+    const RingSlot& slot = slots_[next_ & mask_];
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq == next_) {
+        frame = &slot;
+        return ReadStatus::Ok;
+    }
+
+    uint64_t w = header_->write_seq.load(std::memory_order_acquire);
+    if (w < next_) return follow_restart() ? peek(frame) : ReadStatus::Empty;
+
+    // Only a writer a full ring ahead, or a slot already holding a later
+    // frame, means next_ is gone.
+    if (w >= next_ + capacity_ || seq > next_) {
+        resync(w);
+        return ReadStatus::Overrun;
+    }
+
+    // Otherwise next_ was published between the two loads above.
+    if (slot.seq.load(std::memory_order_acquire) == next_) {
+        frame = &slot;
+        return ReadStatus::Ok;
+    }
+    return ReadStatus::Empty;
+}
+
+ReadStatus FrameRingReader::advance() {
+    if (!slots_) return ReadStatus::Empty;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const RingSlot& slot = slots_[next_ & mask_];
+    if (slot.seq.load(std::memory_order_relaxed) != next_) {
+        resync(header_->write_seq.load(std::memory_order_acquire));
+        return ReadStatus::Overrun;
+    }
+
+    ++next_;
+    return ReadStatus::Ok;
+}
+
+} // namespace shm_ring
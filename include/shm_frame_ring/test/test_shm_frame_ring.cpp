@@ -0,0 +1,239 @@
+#include "shm_frame_ring.hpp"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+
+using namespace shm_ring;
+
+namespace {
+
+std::string unique_name(const char* tag) {
+    return std::string("shm_ring_test_") + tag + "_" + std::to_string(getpid());
+}
+
+} // namespace
+
+TEST(ShmFrameRingTest, CapacityRoundsUpToPowerOfTwo) {
+    FrameRingWriter writer(unique_name("cap"), 1000);
+    EXPECT_EQ(writer.capacity(), 1024u);
+}
+
+TEST(ShmFrameRingTest, ReaderSeesPublishedFrames) {
+    auto name = unique_name("basic");
+    FrameRingWriter writer(name, 16);
+    ASSERT_TRUE(writer.open());
+
+    FrameRingReader reader(name);
+    ASSERT_TRUE(reader.open());
+
+    const RingSlot* frame = nullptr;
+    EXPECT_EQ(reader.peek(frame), ReadStatus::Empty);
+
+    std::vector<uint8_t> payload = {0xDE, 0xAD, 0xBE, 0xEF};
+    ASSERT_TRUE(writer.publish(Direction::UsbToHost, 0x123, payload, 42));
+    ASSERT_TRUE(writer.publish(Direction::HostToUsb, 0x456, {}, 43));
+
+    ASSERT_EQ(reader.peek(frame), ReadStatus::Ok);
+    EXPECT_EQ(frame->can_id, 0x123u);
+    EXPECT_EQ(frame->len, 4);
+    EXPECT_EQ(frame->direction, Direction::UsbToHost);
+    EXPECT_EQ(frame->timestamp_ns, 42u);
+    EXPECT_EQ(frame->data[3], 0xEF);
+    EXPECT_EQ(reader.advance(), ReadStatus::Ok);
+
+    ASSERT_EQ(reader.peek(frame), ReadStatus::Ok);
+    EXPECT_EQ(frame->can_id, 0x456u);
+    EXPECT_EQ(frame->direction, Direction::HostToUsb);
+    EXPECT_EQ(reader.advance(), ReadStatus::Ok);
+
+    EXPECT_EQ(reader.peek(frame), ReadStatus::Empty);
+    EXPECT_EQ(reader.lost(), 0u);
+
+    writer.unlink();
+}
+
+TEST(ShmFrameRingTest, RejectsOversizedPayload) {
+    auto name = unique_name("oversize");
+    FrameRingWriter writer(name, 16);
+    ASSERT_TRUE(writer.open());
+    std::vector<uint8_t> oversized(kMaxFrameData + 1, 0xFF);
+    EXPECT_FALSE(writer.publish(Direction::UsbToHost, 0x1, oversized));
+    writer.unlink();
+}
+
+TEST(ShmFrameRingTest, SlowReaderDetectsOverrun) {
+    auto name = unique_name("overrun");
+    FrameRingWriter writer(name, 8);
+    ASSERT_TRUE(writer.open());
+
+    FrameRingReader reader(name);
+    ASSERT_TRUE(reader.open());
+
+    for (uint32_t i = 0; i < 20; ++i) {
+        uint8_t b = static_cast<uint8_t>(i);
+        writer.publish(Direction::UsbToHost, i, {&b, 1});
+    }
+
+    const RingSlot* frame = nullptr;
+    EXPECT_EQ(reader.peek(frame), ReadStatus::Overrun);
+    EXPECT_GT(reader.lost(), 0u);
+
+    ASSERT_EQ(reader.peek(frame), ReadStatus::Ok);
+    EXPECT_EQ(frame->can_id + 1, reader.next_sequence());
+    EXPECT_EQ(reader.advance(), ReadStatus::Ok);
+
+    writer.unlink();
+}
+
+TEST(ShmFrameRingTest, MultipleReadersFollowIndependently) {
+    auto name = unique_name("multi");
+    FrameRingWriter writer(name, 1024);
+    ASSERT_TRUE(writer.open());
+
+    FrameRingReader a(name), b(name);
+    ASSERT_TRUE(a.open());
+    ASSERT_TRUE(b.open());
+
+    constexpr uint32_t kFrames = 500;
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < kFrames; ++i) {
+            writer.publish(Direction::UsbToHost, i, {});
+        }
+    });
+    producer.join();
+
+    for (auto* reader : {&a, &b}) {
+        uint32_t expected = 0;
+        const RingSlot* frame = nullptr;
+        while (reader->peek(frame) == ReadStatus::Ok) {
+            EXPECT_EQ(frame->can_id, expected++);
+            ASSERT_EQ(reader->advance(), ReadStatus::Ok);
+        }
+        EXPECT_EQ(expected, kFrames);
+        EXPECT_EQ(reader->lost(), 0u);
+    }
+
+    writer.unlink();
+}
+
+TEST(ShmFrameRingTest, CaughtUpReaderNeverReportsOverrun) {
+    auto name = unique_name("caught_up");
+    FrameRingWriter writer(name, 64);
+    ASSERT_TRUE(writer.open());
+
+    FrameRingReader reader(name);
+    ASSERT_TRUE(reader.open());
+
+    // The writer never gets more than half a ring ahead, so every frame
+    // survives and any Overrun would be a false alarm from a publish racing
+    // the reader's checks.
+    constexpr uint32_t kFrames = 100000;
+    std::atomic<uint32_t> consumed = 0;
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < kFrames; ++i) {
+            while (i - consumed.load() >= writer.capacity() / 2) std::this_thread::yield();
+            writer.publish(Direction::UsbToHost, i, {});
+        }
+    });
+
+    uint32_t overruns = 0;
+    const RingSlot* frame = nullptr;
+    while (consumed < kFrames) {
+        auto status = reader.peek(frame);
+        if (status == ReadStatus::Overrun) ++overruns;
+        if (status != ReadStatus::Ok) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(frame->can_id, consumed.load());
+        ASSERT_EQ(reader.advance(), ReadStatus::Ok);
+        ++consumed;
+    }
+    producer.join();
+
+    EXPECT_EQ(overruns, 0u);
+    EXPECT_EQ(reader.lost(), 0u);
+
+    writer.unlink();
+}
+
+TEST(ShmFrameRingTest, ReaderFollowsWriterRestartIntoSmallerRing) {
+    auto name = unique_name("restart");
+    auto writer = std::make_unique<FrameRingWriter>(name, 64);
+    ASSERT_TRUE(writer->open());
+
+    FrameRingReader reader(name);
+    ASSERT_TRUE(reader.open());
+
+    for (uint32_t i = 0; i < 40; ++i) writer->publish(Direction::UsbToHost, i, {});
+
+    const RingSlot* frame = nullptr;
+    for (uint32_t i = 0; i < 5; ++i) {
+        ASSERT_EQ(reader.peek(frame), ReadStatus::Ok);
+        ASSERT_EQ(reader.advance(), ReadStatus::Ok);
+    }
+
+    // The bridge comes back with a ring an eighth of the size. The frames
+    // still unread sit in slots past the end of the new object.
+    writer.reset();
+    writer = std::make_unique<FrameRingWriter>(name, 8);
+    ASSERT_TRUE(writer->open());
+    for (uint32_t i = 1000; i < 1003; ++i) writer->publish(Direction::HostToUsb, i, {});
+
+    std::vector<uint32_t> ids;
+    while (reader.peek(frame) == ReadStatus::Ok) {
+        ids.push_back(frame->can_id);
+        ASSERT_EQ(reader.advance(), ReadStatus::Ok);
+    }
+
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 5; i < 40; ++i) expected.push_back(i);
+    for (uint32_t i = 1000; i < 1003; ++i) expected.push_back(i);
+    EXPECT_EQ(ids, expected);
+    EXPECT_EQ(reader.capacity(), 8u);
+    EXPECT_EQ(reader.restarts(), 1u);
+    EXPECT_EQ(reader.lost(), 0u);
+
+    writer->unlink();
+}
+
+TEST(ShmFrameRingTest, CaughtUpReaderSeesRestartedWriterFromItsFirstFrame) {
+    auto name = unique_name("restart_caught_up");
+    auto writer = std::make_unique<FrameRingWriter>(name, 16);
+    ASSERT_TRUE(writer->open());
+
+    FrameRingReader reader(name);
+    ASSERT_TRUE(reader.open());
+
+    const RingSlot* frame = nullptr;
+    for (uint32_t i = 0; i < 100; ++i) {
+        writer->publish(Direction::UsbToHost, i, {});
+        ASSERT_EQ(reader.peek(frame), ReadStatus::Ok);
+        ASSERT_EQ(reader.advance(), ReadStatus::Ok);
+    }
+    EXPECT_EQ(reader.peek(frame), ReadStatus::Empty);
+
+    // Sequence numbers start over at 1, far behind where the reader is.
+    writer.reset();
+    writer = std::make_unique<FrameRingWriter>(name, 16);
+    ASSERT_TRUE(writer->open());
+    writer->publish(Direction::UsbToHost, 0x7FF, {});
+
+    ASSERT_EQ(reader.peek(frame), ReadStatus::Ok);
+    EXPECT_EQ(frame->can_id, 0x7FFu);
+    EXPECT_EQ(reader.advance(), ReadStatus::Ok);
+    EXPECT_EQ(reader.peek(frame), ReadStatus::Empty);
+    EXPECT_EQ(reader.restarts(), 1u);
+
+    writer->unlink();
+}
+
+TEST(ShmFrameRingTest, OpenMissingRingFails) {
+    FrameRingReader reader(unique_name("missing"));
+    EXPECT_FALSE(reader.open());
+}
@@ -10,6 +10,10 @@
 #include <functional>
 #include <optional>
 #include <span>
+#include <atomic>
+#include <chrono>
+
+#include "wait_strategy.hpp"
 
 class SocketCanInterface {
 public:
@@ -36,11 +40,32 @@ public:
     void close_device();
 
     Status send_frame(uint32_t can_id, std::span<const uint8_t> data);
-    std::optional<std::pair<uint32_t, std::vector<uint8_t>>> recv_frame();
+    // Waits up to `timeout_ms` for a frame using the configured wait strategy;
+    // the default of 0 only checks for one already queued.
+    std::optional<std::pair<uint32_t, std::vector<uint8_t>>> recv_frame(int timeout_ms = 0);
 
     void set_debug(bool flag);
     bool is_debug() const;
     int get_fd() const;
+    const std::string& interface_name() const;
+
+    // Frames the kernel dropped because this socket's receive queue was full
+    // (SO_RXQ_OVFL). The counter rides along with received frames, so it is
+    // current as of the last successful recv_frame().
+    uint32_t rx_queue_drops() const;
+    bool set_receive_buffer(int bytes);
+    int receive_buffer() const;
+
+    // How recv_frame() waits when given a timeout (default: Block). Every
+    // received frame restarts the adaptive spin window, so only the
+    // receiving thread may call recv_frame().
+    void set_wait_strategy(WaitMode mode,
+                           std::chrono::microseconds spin_window = std::chrono::microseconds(200));
+    WaitStats wait_stats() const;
+    // SO_BUSY_POLL: let the kernel poll the device queue for `usec` on an
+    // empty read instead of sleeping. Needs CAP_NET_ADMIN above
+    // net.core.busy_read; 0 disables it.
+    bool set_busy_poll(int usec);
 
 private:
     std::string _interface_name;
@@ -49,9 +74,13 @@ private:
     bool _debug;
     std::function<void(const std::string&)> _logger;
 
+    std::atomic<uint32_t> _rx_queue_drops;
+    WaitStrategy _wait;
+
     std::mutex _send_mutex;
     std::mutex _recv_mutex;
 
     void log(const std::string &message) const;
-    bool poll_readable(int timeout_ms) const;
+    bool poll_readable(int timeout_ms);
+    ssize_t read_frame(void *frame, size_t size);
 };
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include <poll.h>
+
+// How a forwarding loop waits for its next frame.
+//   Block     sleep in poll() until a descriptor is readable
+//   Spin      never sleep: re-check the descriptors until one is readable
+//   Adaptive  spin for a window after each frame, then block
+// Adaptive keeps the turnaround of a spinning loop while traffic flows and
+// drops to zero CPU once the bus goes quiet.
+enum class WaitMode {
+    Block,
+    Spin,
+    Adaptive
+};
+
+struct WaitStats {
+    uint64_t spin_hits = 0;     // readable while spinning: no sleep/wake cycle paid
+    uint64_t sleeps = 0;        // blocking waits entered
+    uint64_t wakeups = 0;       // blocking waits that ended readable
+    uint64_t spin_ns = 0;       // time spent spinning
+
+    // Share of readable waits that never slept.
+    double spin_hit_ratio() const {
+        uint64_t ready = spin_hits + wakeups;
+        return ready ? 100.0 * spin_hits / ready : 0.0;
+    }
+
+    WaitStats& operator+=(const WaitStats& other) {
+        spin_hits += other.spin_hits;
+        sleeps += other.sleeps;
+        wakeups += other.wakeups;
+        spin_ns += other.spin_ns;
+        return *this;
+    }
+};
+
+// One instance per waiting thread. stats() may be called from any thread.
+class WaitStrategy {
+public:
+    explicit WaitStrategy(WaitMode mode = WaitMode::Block,
+                          std::chrono::microseconds spin_window = std::chrono::microseconds(200));
+
+    // Waits until one of `fds` is readable or `timeout_ms` passes. Negative
+    // descriptors are ignored. Returns true if something is readable.
+    bool wait_readable(std::span<const int> fds, int timeout_ms);
+    bool wait_readable(std::initializer_list<int> fds, int timeout_ms);
+
+    // Restarts the adaptive spin window. A loop that drains several frames
+    // per wait calls this after each one, so the window runs from the last
+    // frame rather than from the wait that found the first.
+    void note_activity();
+
+    void set_mode(WaitMode mode, std::chrono::microseconds spin_window);
+    WaitMode mode() const;
+    WaitStats stats() const;
+
+    // `block`, `spin` or `adaptive`.
+    static bool parse_mode(const char* text, WaitMode& mode);
+
+private:
+    WaitMode _mode;
+    std::chrono::nanoseconds _spin_window;
+    std::chrono::steady_clock::time_point _last_ready;
+
+    std::atomic<uint64_t> _spin_hits;
+    std::atomic<uint64_t> _sleeps;
+    std::atomic<uint64_t> _wakeups;
+    std::atomic<uint64_t> _spin_ns;
+
+    // Reused by every poll(); grows to the largest descriptor set seen.
+    std::vector<struct pollfd> _pfds;
+
+    int poll_fds(std::span<const int> fds, int timeout_ms);
+    bool spin(std::span<const int> fds, std::chrono::steady_clock::time_point until);
+    bool block(std::span<const int> fds, int timeout_ms);
+};
+
+std::string format_wait_stats(const std::string& label, const WaitStats& stats);
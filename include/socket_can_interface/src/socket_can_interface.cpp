@@ -1,11 +1,11 @@
 // socket_can_interface.cpp
 #include "socket_can_interface.hpp"
+#include "can_trace.hpp"
 #include <net/if.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <poll.h>
 #include <cstring>
 #include <iostream>
 #include <sstream>
@@ -14,7 +14,8 @@
 SocketCanInterface::SocketCanInterface(const std::string &interface_name, Mode mode,
                                        bool debug,
                                        std::function<void(const std::string&)> logger)
-    : _interface_name(interface_name), _socket_fd(-1), _mode(mode), _debug(debug), _logger(std::move(logger)) {}
+    : _interface_name(interface_name), _socket_fd(-1), _mode(mode), _debug(debug), _logger(std::move(logger)),
+      _rx_queue_drops(0) {}
 
 SocketCanInterface::~SocketCanInterface() {
     close_device();
@@ -32,6 +33,50 @@ int SocketCanInterface::get_fd() const {
     return _socket_fd;
 }
 
+const std::string& SocketCanInterface::interface_name() const {
+    return _interface_name;
+}
+
+uint32_t SocketCanInterface::rx_queue_drops() const {
+    return _rx_queue_drops;
+}
+
+bool SocketCanInterface::set_receive_buffer(int bytes) {
+    if (_socket_fd < 0) return false;
+
+    // SO_RCVBUFFORCE may exceed net.core.rmem_max but needs CAP_NET_ADMIN.
+    if (setsockopt(_socket_fd, SOL_SOCKET, SO_RCVBUFFORCE, &bytes, sizeof(bytes)) == 0) return true;
+    if (setsockopt(_socket_fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes)) < 0) {
+        perror("setsockopt SO_RCVBUF");
+        return false;
+    }
+    return true;
+}
+
+int SocketCanInterface::receive_buffer() const {
+    int bytes = 0;
+    socklen_t len = sizeof(bytes);
+    if (_socket_fd < 0 || getsockopt(_socket_fd, SOL_SOCKET, SO_RCVBUF, &bytes, &len) < 0) return -1;
+    return bytes;
+}
+
+void SocketCanInterface::set_wait_strategy(WaitMode mode, std::chrono::microseconds spin_window) {
+    _wait.set_mode(mode, spin_window);
+}
+
+WaitStats SocketCanInterface::wait_stats() const {
+    return _wait.stats();
+}
+
+bool SocketCanInterface::set_busy_poll(int usec) {
+    if (_socket_fd < 0) return false;
+    if (setsockopt(_socket_fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0) {
+        perror("setsockopt SO_BUSY_POLL");
+        return false;
+    }
+    return true;
+}
+
 void SocketCanInterface::log(const std::string &message) const {
     if (_debug && _logger) {
         _logger(message);
@@ -55,6 +100,12 @@ SocketCanInterface::Status SocketCanInterface::open_device() {
         }
     }
 
+    int enable_ovfl = 1;
+    if (setsockopt(_socket_fd, SOL_SOCKET, SO_RXQ_OVFL, &enable_ovfl, sizeof(enable_ovfl)) < 0) {
+        perror("setsockopt SO_RXQ_OVFL");
+    }
+    _rx_queue_drops = 0;
+
     struct ifreq ifr;
     std::strncpy(ifr.ifr_name, _interface_name.c_str(), IFNAMSIZ);
     if (ioctl(_socket_fd, SIOCGIFINDEX, &ifr) < 0) {
@@ -102,6 +153,7 @@ SocketCanInterface::Status SocketCanInterface::send_frame(uint32_t can_id, std::
             perror("send_frame: write FD");
             return Status::WriteFailed;
         }
+        CAN_TRACE(socket_send, can_id, data.size(), can_trace::now_ns());
     } else {
         if (data.size() > 8) return Status::InvalidDataLength;
         struct can_frame frame = {};
@@ -114,6 +166,7 @@ SocketCanInterface::Status SocketCanInterface::send_frame(uint32_t can_id, std::
             perror("send_frame: write");
             return Status::WriteFailed;
         }
+        CAN_TRACE(socket_send, can_id, data.size(), can_trace::now_ns());
     }
 
     std::ostringstream oss;
@@ -129,21 +182,45 @@ SocketCanInterface::Status SocketCanInterface::send_frame(uint32_t can_id, std::
     return Status::Success;
 }
 
-bool SocketCanInterface::poll_readable(int timeout_ms) const {
-    struct pollfd fds = { _socket_fd, POLLIN, 0 };
-    return poll(&fds, 1, timeout_ms) > 0;
+bool SocketCanInterface::poll_readable(int timeout_ms) {
+    return _wait.wait_readable({ _socket_fd }, timeout_ms);
+}
+
+ssize_t SocketCanInterface::read_frame(void *frame, size_t size) {
+    struct iovec iov = { frame, size };
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(uint32_t))];
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t nbytes = recvmsg(_socket_fd, &msg, 0);
+    if (nbytes <= 0) return nbytes;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            std::memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+            _rx_queue_drops = drops;
+        }
+    }
+    return nbytes;
 }
 
-std::optional<std::pair<uint32_t, std::vector<uint8_t>>> SocketCanInterface::recv_frame() {
+std::optional<std::pair<uint32_t, std::vector<uint8_t>>> SocketCanInterface::recv_frame(int timeout_ms) {
     if (_socket_fd < 0) return std::nullopt;
-    if (!poll_readable(0)) return std::nullopt;
+    if (!poll_readable(timeout_ms)) return std::nullopt;
 
     std::lock_guard<std::mutex> lock(_recv_mutex);
 
     if (_mode == Mode::CAN_FD) {
         struct canfd_frame frame_fd;
-        int nbytes = read(_socket_fd, &frame_fd, sizeof(frame_fd));
+        int nbytes = read_frame(&frame_fd, sizeof(frame_fd));
         if (nbytes <= 0) return std::nullopt;
+        _wait.note_activity();
+        CAN_TRACE(socket_recv, frame_fd.can_id, frame_fd.len, can_trace::now_ns());
 
         std::vector<uint8_t> data(frame_fd.data, frame_fd.data + frame_fd.len);
         std::ostringstream oss;
@@ -158,8 +235,10 @@ std::optional<std::pair<uint32_t, std::vector<uint8_t>>> SocketCanInterface::rec
         return std::make_pair(frame_fd.can_id, data);
     } else {
         struct can_frame frame;
-        int nbytes = read(_socket_fd, &frame, sizeof(frame));
+        int nbytes = read_frame(&frame, sizeof(frame));
         if (nbytes <= 0) return std::nullopt;
+        _wait.note_activity();
+        CAN_TRACE(socket_recv, frame.can_id, frame.can_dlc, can_trace::now_ns());
 
         std::vector<uint8_t> data(frame.data, frame.data + frame.can_dlc);
         std::ostringstream oss;
@@ -0,0 +1,122 @@
+// wait_strategy.cpp
+#include "wait_strategy.hpp"
+#include <poll.h>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+WaitStrategy::WaitStrategy(WaitMode mode, std::chrono::microseconds spin_window)
+    : _mode(mode), _spin_window(spin_window), _spin_hits(0), _sleeps(0), _wakeups(0), _spin_ns(0) {}
+
+void WaitStrategy::set_mode(WaitMode mode, std::chrono::microseconds spin_window) {
+    _mode = mode;
+    _spin_window = spin_window;
+}
+
+WaitMode WaitStrategy::mode() const {
+    return _mode;
+}
+
+WaitStats WaitStrategy::stats() const {
+    WaitStats s;
+    s.spin_hits = _spin_hits;
+    s.sleeps = _sleeps;
+    s.wakeups = _wakeups;
+    s.spin_ns = _spin_ns;
+    return s;
+}
+
+void WaitStrategy::note_activity() {
+    _last_ready = std::chrono::steady_clock::now();
+}
+
+// poll() skips negative descriptors itself, so they are passed through.
+int WaitStrategy::poll_fds(std::span<const int> fds, int timeout_ms) {
+    _pfds.resize(fds.size());
+    for (size_t i = 0; i < fds.size(); ++i) _pfds[i] = { fds[i], POLLIN, 0 };
+    return poll(_pfds.data(), _pfds.size(), timeout_ms);
+}
+
+bool WaitStrategy::parse_mode(const char* text, WaitMode& mode) {
+    if (std::strcmp(text, "block") == 0) mode = WaitMode::Block;
+    else if (std::strcmp(text, "spin") == 0) mode = WaitMode::Spin;
+    else if (std::strcmp(text, "adaptive") == 0) mode = WaitMode::Adaptive;
+    else return false;
+    return true;
+}
+
+bool WaitStrategy::spin(std::span<const int> fds, std::chrono::steady_clock::time_point until) {
+    auto start = std::chrono::steady_clock::now();
+    auto now = start;
+    bool ready = false;
+    do {
+        if (poll_fds(fds, 0) > 0) {
+            ready = true;
+            break;
+        }
+        now = std::chrono::steady_clock::now();
+    } while (now < until);
+
+    if (ready) now = std::chrono::steady_clock::now();
+    _spin_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+    if (ready) {
+        ++_spin_hits;
+        _last_ready = now;
+    }
+    return ready;
+}
+
+bool WaitStrategy::block(std::span<const int> fds, int timeout_ms) {
+    ++_sleeps;
+    if (poll_fds(fds, timeout_ms) <= 0) return false;
+    ++_wakeups;
+    _last_ready = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool WaitStrategy::wait_readable(std::initializer_list<int> fds, int timeout_ms) {
+    return wait_readable(std::span<const int>(fds.begin(), fds.size()), timeout_ms);
+}
+
+bool WaitStrategy::wait_readable(std::span<const int> fds, int timeout_ms) {
+    if (std::none_of(fds.begin(), fds.end(), [](int fd) { return fd >= 0; })) return false;
+
+    // A zero timeout is a plain readiness check in every mode.
+    if (timeout_ms == 0) {
+        if (poll_fds(fds, 0) <= 0) return false;
+        _last_ready = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto deadline = now + std::chrono::milliseconds(timeout_ms);
+
+    switch (_mode) {
+        case WaitMode::Block:
+            return block(fds, timeout_ms);
+
+        case WaitMode::Spin:
+            return spin(fds, deadline);
+
+        case WaitMode::Adaptive: {
+            auto window_end = std::min(_last_ready + _spin_window, deadline);
+            if (now < window_end && spin(fds, window_end)) return true;
+
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) return false;
+            return block(fds, static_cast<int>(remaining));
+        }
+    }
+    return false;
+}
+
+std::string format_wait_stats(const std::string& label, const WaitStats& s) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+        << label << " wait: " << s.spin_hits << " spin hits, " << s.sleeps << " sleeps ("
+        << s.wakeups << " woken by data), " << s.spin_hit_ratio() << "% ready without sleeping, "
+        << s.spin_ns / 1e6 << " ms spinning";
+    return oss.str();
+}
@@ -52,6 +52,23 @@ TEST(SocketCanInterfaceTest, InvalidSendDataLength) {
     iface.close_device();
 }
 
+TEST(SocketCanInterfaceTest, ReceiveBufferRequiresOpenSocket) {
+    SocketCanInterface iface("vcan0");
+    EXPECT_FALSE(iface.set_receive_buffer(1 << 20));
+    EXPECT_EQ(iface.receive_buffer(), -1);
+    EXPECT_EQ(iface.rx_queue_drops(), 0u);
+}
+
+TEST(SocketCanInterfaceTest, ReceiveBufferCanGrow) {
+    SocketCanInterface iface("vcan0");
+    ASSERT_EQ(iface.open_device(), SocketCanInterface::Status::Success);
+    int before = iface.receive_buffer();
+    ASSERT_GT(before, 0);
+    EXPECT_TRUE(iface.set_receive_buffer(before));
+    EXPECT_GE(iface.receive_buffer(), before);
+    iface.close_device();
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,154 @@
+#include "wait_strategy.hpp"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+// A pipe stands in for the CAN socket: only readiness matters here.
+class WaitStrategyTest : public ::testing::Test {
+protected:
+    int fds[2] = { -1, -1 };
+
+    void SetUp() override { ASSERT_EQ(pipe(fds), 0); }
+    void TearDown() override {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    void make_readable() { ASSERT_EQ(write(fds[1], "x", 1), 1); }
+    void drain() {
+        char c;
+        ASSERT_EQ(read(fds[0], &c, 1), 1);
+    }
+};
+
+TEST_F(WaitStrategyTest, ParseMode) {
+    WaitMode mode = WaitMode::Block;
+    EXPECT_TRUE(WaitStrategy::parse_mode("adaptive", mode));
+    EXPECT_EQ(mode, WaitMode::Adaptive);
+    EXPECT_TRUE(WaitStrategy::parse_mode("spin", mode));
+    EXPECT_EQ(mode, WaitMode::Spin);
+    EXPECT_FALSE(WaitStrategy::parse_mode("sleepy", mode));
+    EXPECT_EQ(mode, WaitMode::Spin);
+}
+
+TEST_F(WaitStrategyTest, IgnoresClosedDescriptors) {
+    WaitStrategy wait(WaitMode::Block);
+    EXPECT_FALSE(wait.wait_readable({ -1 }, 50));
+    EXPECT_EQ(wait.stats().sleeps, 0u);
+}
+
+TEST_F(WaitStrategyTest, BlockSleepsAndWakes) {
+    WaitStrategy wait(WaitMode::Block);
+    EXPECT_FALSE(wait.wait_readable({ fds[0] }, 10));
+
+    std::thread writer([this] {
+        std::this_thread::sleep_for(5ms);
+        make_readable();
+    });
+    EXPECT_TRUE(wait.wait_readable({ fds[0] }, 1000));
+    writer.join();
+
+    auto s = wait.stats();
+    EXPECT_EQ(s.sleeps, 2u);
+    EXPECT_EQ(s.wakeups, 1u);
+    EXPECT_EQ(s.spin_hits, 0u);
+}
+
+TEST_F(WaitStrategyTest, AdaptiveSpinsOnlyAfterActivity) {
+    WaitStrategy wait(WaitMode::Adaptive, 50ms);
+
+    // Nothing seen yet: no window to spin in, so the first wait blocks.
+    make_readable();
+    EXPECT_TRUE(wait.wait_readable({ fds[0] }, 100));
+    drain();
+    EXPECT_EQ(wait.stats().sleeps, 1u);
+
+    // Within the window a frame that arrives is caught while spinning.
+    std::thread writer([this] {
+        std::this_thread::sleep_for(2ms);
+        make_readable();
+    });
+    EXPECT_TRUE(wait.wait_readable({ fds[0] }, 100));
+    writer.join();
+    drain();
+
+    auto s = wait.stats();
+    EXPECT_EQ(s.spin_hits, 1u);
+    EXPECT_EQ(s.sleeps, 1u);
+    EXPECT_GT(s.spin_ns, 0u);
+}
+
+TEST_F(WaitStrategyTest, AdaptiveBlocksAfterWindow) {
+    WaitStrategy wait(WaitMode::Adaptive, 2ms);
+    make_readable();
+    EXPECT_TRUE(wait.wait_readable({ fds[0] }, 100));
+    drain();
+
+    // The window lapses with the pipe empty; the remainder is spent asleep.
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(wait.wait_readable({ fds[0] }, 20));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+
+    auto s = wait.stats();
+    EXPECT_EQ(s.sleeps, 2u);
+    EXPECT_EQ(s.spin_hits, 0u);
+    EXPECT_GE(s.spin_ns, 1000000u);
+    EXPECT_LT(s.spin_ns, 20000000u);
+}
+
+TEST_F(WaitStrategyTest, WaitsOnAnyDescriptor) {
+    int other[2];
+    ASSERT_EQ(pipe(other), 0);
+    WaitStrategy wait(WaitMode::Spin);
+    ASSERT_EQ(write(other[1], "x", 1), 1);
+    EXPECT_TRUE(wait.wait_readable({ -1, fds[0], other[0] }, 100));
+    EXPECT_EQ(wait.stats().spin_hits, 1u);
+    close(other[0]);
+    close(other[1]);
+}
+
+TEST_F(WaitStrategyTest, NoteActivityRestartsSpinWindow) {
+    WaitStrategy wait(WaitMode::Adaptive, 30ms);
+    make_readable();
+    EXPECT_TRUE(wait.wait_readable({ fds[0] }, 100));
+    drain();
+
+    // Frames processed without waiting keep the window open past its
+    // original end, as long as each one is noted.
+    for (int i = 0; i < 4; ++i) {
+        std::this_thread::sleep_for(10ms);
+        wait.note_activity();
+    }
+    std::thread writer([this] {
+        std::this_thread::sleep_for(2ms);
+        make_readable();
+    });
+    EXPECT_TRUE(wait.wait_readable({ fds[0] }, 1000));
+    writer.join();
+
+    auto s = wait.stats();
+    EXPECT_EQ(s.spin_hits, 1u);
+    EXPECT_EQ(s.sleeps, 1u);
+}
+
+TEST_F(WaitStrategyTest, WaitsOnMoreThanFourDescriptors) {
+    int extra[6][2];
+    std::vector<int> read_ends;
+    for (auto& p : extra) {
+        ASSERT_EQ(pipe(p), 0);
+        read_ends.push_back(p[0]);
+    }
+    WaitStrategy wait(WaitMode::Block);
+    ASSERT_EQ(write(extra[5][1], "x", 1), 1);
+    EXPECT_TRUE(wait.wait_readable(read_ends, 100));
+    EXPECT_EQ(wait.stats().wakeups, 1u);
+    for (auto& p : extra) {
+        close(p[0]);
+        close(p[1]);
+    }
+}
@@ -0,0 +1,98 @@
+// example/main.cpp — remote end of a bridge tunnel: relays between UDP and a SocketCAN interface
+#include "udp_can_tunnel.hpp"
+#include "socket_can_interface.hpp"
+
+#include <iostream>
+#include <thread>
+#include <csignal>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+std::atomic<bool> keep_running{true};
+
+void signal_handler(int) {
+    keep_running = false;
+}
+
+void print_usage() {
+    std::cout << "Usage: can_tunnel_relay [options]\n"
+              << "  -i, --iface <name>     SocketCAN interface (default: vcan0)\n"
+              << "  -b, --bind <[addr:]port> Local UDP endpoint (default: 0.0.0.0:5800)\n"
+              << "  -p, --peer <host:port> Bridge to send to (default: whoever sent last)\n"
+              << "      --latency-us <us>  Max time a frame waits for its datagram to fill (default: 1000)\n"
+              << "      --fd               Use CAN FD\n"
+              << "      --debug            Enable debug output\n"
+              << "      --help             Show this help message\n";
+}
+
+int main(int argc, char* argv[]) {
+    using namespace can_tunnel;
+
+    std::string iface = "vcan0";
+    TunnelConfig config;
+    bool use_fd = false;
+    bool debug = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if ((std::strcmp(argv[i], "--iface") == 0 || std::strcmp(argv[i], "-i") == 0) && i + 1 < argc) {
+            iface = argv[++i];
+        } else if ((std::strcmp(argv[i], "--bind") == 0 || std::strcmp(argv[i], "-b") == 0) && i + 1 < argc) {
+            config.bind = argv[++i];
+        } else if ((std::strcmp(argv[i], "--peer") == 0 || std::strcmp(argv[i], "-p") == 0) && i + 1 < argc) {
+            config.peer = argv[++i];
+        } else if (std::strcmp(argv[i], "--latency-us") == 0 && i + 1 < argc) {
+            config.max_latency_us = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--fd") == 0) {
+            use_fd = true;
+        } else if (std::strcmp(argv[i], "--debug") == 0) {
+            debug = true;
+        } else if (std::strcmp(argv[i], "--help") == 0) {
+            print_usage();
+            return 0;
+        }
+    }
+
+    auto logger = [](const std::string& msg) { std::cerr << "[LOG] " << msg << "\n"; };
+
+    SocketCanInterface sock(iface, use_fd ? SocketCanInterface::Mode::CAN_FD : SocketCanInterface::Mode::CAN_2_0,
+                            debug, logger);
+    if (sock.open_device() != SocketCanInterface::Status::Success) {
+        std::cerr << "Failed to open SocketCAN interface " << iface << std::endl;
+        return 1;
+    }
+
+    UdpTunnel tunnel(config, debug, logger);
+    if (!tunnel.open()) {
+        std::cerr << "Failed to open tunnel on " << config.bind << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    std::thread tunnel_to_sock([&]() {
+        std::vector<TunnelFrame> frames;
+        while (keep_running) {
+            frames.clear();
+            tunnel.receive(frames, 100);
+            for (const auto& frame : frames) sock.send_frame(frame.can_id, frame.payload());
+        }
+    });
+
+    while (keep_running) {
+        auto frame = sock.recv_frame();
+        if (!frame) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        tunnel.send(frame->first, frame->second, UdpTunnel::now_ns());
+    }
+
+    tunnel_to_sock.join();
+    std::cerr << format_counters(tunnel.counters()) << std::endl;
+    tunnel.close();
+    sock.close_device();
+    return 0;
+}
@@ -0,0 +1,105 @@
+// example/tunnel_bench.cpp — CPU cost per frame, batched vs. one datagram per frame
+#include "udp_can_tunnel.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <time.h>
+
+namespace {
+
+using namespace can_tunnel;
+
+struct BenchResult {
+    size_t delivered = 0;
+    double frames_per_datagram = 0;
+    double cpu_us_per_frame = 0;
+    double wall_ms = 0;
+};
+
+double process_cpu_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Sender and receiver share the process, so the CPU time covers both ends.
+BenchResult run(size_t frames, bool batched) {
+    TunnelConfig rx_config;
+    rx_config.bind = "127.0.0.1:0";
+    UdpTunnel receiver(rx_config);
+    if (!receiver.open()) return {};
+
+    TunnelConfig tx_config;
+    tx_config.bind = "127.0.0.1:0";
+    tx_config.peer = "127.0.0.1:" + std::to_string(receiver.local_port());
+    if (!batched) tx_config.batch = 1;
+    UdpTunnel sender(tx_config);
+    if (!sender.open()) return {};
+
+    std::atomic<bool> done{false};
+    size_t delivered = 0;
+    const double cpu_start = process_cpu_us();
+    const auto wall_start = std::chrono::steady_clock::now();
+
+    std::thread rx([&]() {
+        std::vector<TunnelFrame> out;
+        while (delivered < frames) {
+            out.clear();
+            size_t n = receiver.receive(out, 100);
+            delivered += n;
+            if (n == 0 && done) break;
+        }
+    });
+
+    std::vector<uint8_t> payload(8);
+    for (size_t i = 0; i < frames; ++i) {
+        payload[0] = static_cast<uint8_t>(i);
+        sender.send(i & 0x7FF, payload, UdpTunnel::now_ns());
+        // One datagram and one syscall per frame, as an unbatched tunnel would.
+        if (!batched) sender.flush();
+    }
+    sender.flush();
+    done = true;
+    rx.join();
+
+    BenchResult result;
+    result.delivered = delivered;
+    result.frames_per_datagram = sender.counters().frames_per_datagram();
+    result.cpu_us_per_frame = (process_cpu_us() - cpu_start) / frames;
+    result.wall_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - wall_start).count();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t frames = 200'000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--help") == 0) {
+            std::cout << "Usage: tunnel_bench [--frames <n>]  (default: 200000)\n";
+            return 0;
+        }
+    }
+
+    std::cout << frames << " classic frames over 127.0.0.1\n"
+              << "Mode        Frames/datagram  CPU us/frame  Delivered  Wall ms\n"
+              << std::fixed;
+    for (bool batched : {false, true}) {
+        BenchResult r = run(frames, batched);
+        std::cout << std::left << std::setw(12) << (batched ? "Batched" : "Per frame") << std::right
+                  << std::setprecision(1) << std::setw(15) << r.frames_per_datagram
+                  << std::setprecision(2) << std::setw(14) << r.cpu_us_per_frame
+                  << std::setprecision(1) << std::setw(10) << 100.0 * r.delivered / frames << "%"
+                  << std::setprecision(0) << std::setw(9) << r.wall_ms << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <span>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace can_tunnel {
+
+// Wire format, all fields little-endian:
+//
+//   datagram: magic u16 "CT" | version u8 | frame count u8 | sequence u32 |
+//             session u32 | base timestamp u64 (ns) | frame...
+//   frame:    timestamp offset u32 (ns from base) | can_id u32 | len u8 |
+//             flags u8 (reserved, 0) | data[len]
+//
+// `can_id` uses the SocketCAN encoding. A classic 8-byte frame costs 18 bytes,
+// so a 1400-byte datagram carries 76 of them.
+//
+// `session` is drawn at random each time an endpoint opens and `sequence`
+// restarts at 0 with it, so a receiver tells a restarted peer from late or
+// lost datagrams by the session changing.
+constexpr uint16_t kTunnelMagic = 0x5443;   // "CT"
+constexpr uint8_t kTunnelVersion = 2;
+constexpr size_t kDatagramHeaderSize = 20;
+constexpr size_t kFrameHeaderSize = 10;
+constexpr size_t kMaxFrameData = 64;
+constexpr size_t kMaxFramesPerDatagram = 255;
+
+struct TunnelFrame {
+    uint64_t timestamp_ns;
+    uint32_t can_id;
+    uint8_t len;
+    uint8_t data[kMaxFrameData];
+
+    std::span<const uint8_t> payload() const { return {data, len}; }
+};
+
+struct TunnelConfig {
+    // Local endpoint, `[address:]port`.
+    std::string bind = "0.0.0.0:5800";
+    // Remote endpoint, `host:port`. Empty: send to whoever sent to us last.
+    std::string peer;
+    // Datagram payload budget; 1400 stays inside a 1500-byte MTU. The
+    // receiving end must be configured with at least the sender's budget.
+    size_t max_datagram = 1400;
+    // A partly filled datagram is sent at most this long after its first frame.
+    uint32_t max_latency_us = 1000;
+    // Datagrams per sendmmsg()/recvmmsg() call.
+    unsigned batch = 32;
+};
+
+struct TunnelCounters {
+    uint64_t frames_sent = 0;
+    uint64_t datagrams_sent = 0;
+    uint64_t send_errors = 0;         // datagrams the kernel refused
+    uint64_t unsent_frames = 0;       // frames flushed before any peer was known
+    uint64_t frames_received = 0;
+    uint64_t datagrams_received = 0;
+    uint64_t lost_datagrams = 0;      // sequence gaps not filled in later
+    uint64_t late_datagrams = 0;      // arrived after a higher sequence number
+    uint64_t malformed_datagrams = 0;
+
+    double frames_per_datagram() const {
+        return datagrams_sent ? static_cast<double>(frames_sent) / datagrams_sent : 0.0;
+    }
+};
+
+// CAN-over-UDP endpoint. send() packs frames into datagrams; a datagram goes
+// out when the next frame would not fit, and full datagrams are sent
+// `batch` at a time with one sendmmsg(). A background flusher bounds the
+// latency of partly filled batches. receive() drains up to `batch` datagrams
+// per recvmmsg() and tracks sequence numbers to count lost datagrams.
+class UdpTunnel {
+public:
+    explicit UdpTunnel(TunnelConfig config, bool debug = false,
+                       std::function<void(const std::string&)> logger = nullptr);
+    ~UdpTunnel();
+
+    bool open();
+    void close();
+
+    // Queues a frame for the peer. Returns false if the frame was rejected or
+    // a batch sent to make room for it failed.
+    bool send(uint32_t can_id, std::span<const uint8_t> data, uint64_t timestamp_ns);
+    bool flush();
+    // Appends received frames to `out`, waiting up to `timeout_ms` for the
+    // first datagram. Returns the number of frames appended.
+    size_t receive(std::vector<TunnelFrame>& out, int timeout_ms);
+
+    TunnelCounters counters() const;
+    uint16_t local_port() const;
+    int get_fd() const;
+    void set_debug(bool enable);
+    bool is_debug() const;
+
+    // Parses one datagram, appending its frames to `out`. Returns false (and
+    // leaves `out` untouched) if the datagram is malformed.
+    static bool decode(std::span<const uint8_t> datagram, uint32_t& session, uint32_t& sequence,
+                       std::vector<TunnelFrame>& out);
+    static uint64_t now_ns();
+
+private:
+    TunnelConfig config_;
+    bool debug_;
+    std::function<void(const std::string&)> logger_;
+    int fd_ = -1;
+
+    // Sender side, guarded by send_mutex_. out_[0..sealed_) are complete
+    // datagrams; out_[sealed_] is being filled.
+    std::mutex send_mutex_;
+    std::condition_variable flush_cv_;
+    std::thread flusher_;
+    bool stop_ = false;
+    std::vector<std::vector<uint8_t>> out_;
+    std::vector<struct iovec> tx_iov_;
+    std::vector<struct mmsghdr> tx_msgs_;
+    size_t sealed_ = 0;
+    size_t pending_frames_ = 0;
+    std::chrono::steady_clock::time_point oldest_;
+    uint32_t session_ = 0;
+    uint32_t next_seq_ = 0;
+    uint64_t base_ts_ = 0;
+    bool have_peer_ = false;
+    struct sockaddr_in peer_ = {};
+
+    // Receiver side, guarded by recv_mutex_.
+    std::mutex recv_mutex_;
+    std::vector<uint8_t> rx_buf_;
+    std::vector<struct iovec> rx_iov_;
+    std::vector<struct mmsghdr> rx_msgs_;
+    std::vector<struct sockaddr_in> rx_from_;
+    bool have_seq_ = false;
+    uint32_t peer_session_ = 0;
+    uint32_t stale_session_ = 0;     // the peer's previous session, if it restarted
+    uint32_t expected_seq_ = 0;
+
+    std::atomic<uint64_t> frames_sent_ = 0;
+    std::atomic<uint64_t> datagrams_sent_ = 0;
+    std::atomic<uint64_t> send_errors_ = 0;
+    std::atomic<uint64_t> unsent_frames_ = 0;
+    std::atomic<uint64_t> frames_received_ = 0;
+    std::atomic<uint64_t> datagrams_received_ = 0;
+    std::atomic<uint64_t> lost_datagrams_ = 0;
+    std::atomic<uint64_t> late_datagrams_ = 0;
+    std::atomic<uint64_t> malformed_datagrams_ = 0;
+
+    void log(const std::string& msg) const;
+    void start_datagram(uint64_t timestamp_ns);
+    void seal_datagram();
+    bool flush_locked();
+    void run_flusher();
+    void track_sequence(uint32_t session, uint32_t sequence);
+    void learn_peer(const struct sockaddr_in& from);
+};
+
+std::string format_counters(const TunnelCounters& counters);
+
+} // namespace can_tunnel
@@ -0,0 +1,422 @@
+#include "udp_can_tunnel.hpp"
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <limits>
+#include <random>
+
+namespace can_tunnel {
+
+namespace {
+
+// Within one session, sequence numbers this far behind the expected one are
+// not reordering; the receiver resyncs instead of counting them late.
+constexpr int32_t kRestartWindow = 1 << 16;
+
+void put_u16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+void put_u32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; ++i) p[i] = v >> (8 * i); }
+void put_u64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; ++i) p[i] = v >> (8 * i); }
+
+uint16_t get_u16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+uint32_t get_u32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+uint64_t get_u64(const uint8_t* p) {
+    return get_u32(p) | (static_cast<uint64_t>(get_u32(p + 4)) << 32);
+}
+
+// `[address:]port` or `host:port`; a bare port binds every local address.
+bool parse_endpoint(const std::string& text, struct sockaddr_in& out) {
+    std::string host, port = text;
+    if (size_t colon = text.rfind(':'); colon != std::string::npos) {
+        host = text.substr(0, colon);
+        port = text.substr(colon + 1);
+    }
+    if (port.empty()) return false;
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = host.empty() ? AI_PASSIVE : 0;
+    struct addrinfo* res = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res) != 0 || !res)
+        return false;
+    std::memcpy(&out, res->ai_addr, sizeof(out));
+    freeaddrinfo(res);
+    return true;
+}
+
+} // namespace
+
+UdpTunnel::UdpTunnel(TunnelConfig config, bool debug, std::function<void(const std::string&)> logger)
+    : config_(std::move(config)), debug_(debug), logger_(std::move(logger)) {
+    config_.max_datagram = std::clamp<size_t>(config_.max_datagram,
+                                              kDatagramHeaderSize + kFrameHeaderSize + kMaxFrameData, 65507);
+    config_.batch = std::max(config_.batch, 1u);
+}
+
+UdpTunnel::~UdpTunnel() { close(); }
+
+void UdpTunnel::set_debug(bool enable) { debug_ = enable; }
+bool UdpTunnel::is_debug() const { return debug_; }
+int UdpTunnel::get_fd() const { return fd_; }
+
+void UdpTunnel::log(const std::string& msg) const {
+    if (debug_) {
+        if (logger_) logger_(msg);
+        else std::cerr << msg << '\n';
+    }
+}
+
+uint64_t UdpTunnel::now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+bool UdpTunnel::open() {
+    struct sockaddr_in local = {};
+    if (!parse_endpoint(config_.bind, local)) {
+        std::cerr << "Invalid tunnel bind address: " << config_.bind << '\n';
+        return false;
+    }
+    if (!config_.peer.empty()) {
+        if (!parse_endpoint(config_.peer, peer_) || peer_.sin_addr.s_addr == htonl(INADDR_ANY)) {
+            std::cerr << "Invalid tunnel peer address: " << config_.peer << '\n';
+            return false;
+        }
+        have_peer_ = true;
+    }
+
+    fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        perror("socket");
+        return false;
+    }
+    if (bind(fd_, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
+        perror("bind");
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    // All buffers and message vectors are sized once here; send() and
+    // receive() only fill them in.
+    const size_t batch = config_.batch;
+    out_.assign(batch, {});
+    for (auto& datagram : out_) datagram.reserve(config_.max_datagram);
+    tx_iov_.assign(batch, {});
+    tx_msgs_.assign(batch, {});
+    sealed_ = 0;
+    pending_frames_ = 0;
+
+    rx_buf_.assign(batch * config_.max_datagram, 0);
+    rx_iov_.assign(batch, {});
+    rx_msgs_.assign(batch, {});
+    rx_from_.assign(batch, {});
+    have_seq_ = false;
+
+    // A fresh session per open: the peer must not read our restarted
+    // sequence as the tail of the previous one.
+    {
+        std::lock_guard lock(send_mutex_);
+        std::random_device rd;
+        session_ = rd();
+        next_seq_ = 0;
+    }
+
+    stop_ = false;
+    flusher_ = std::thread([this]() { run_flusher(); });
+
+    log("Tunnel bound to " + config_.bind + (have_peer_ ? ", peer " + config_.peer : ", waiting for a peer"));
+    return true;
+}
+
+void UdpTunnel::close() {
+    if (flusher_.joinable()) {
+        {
+            std::lock_guard lock(send_mutex_);
+            flush_locked();
+            stop_ = true;
+        }
+        flush_cv_.notify_all();
+        flusher_.join();
+    }
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void UdpTunnel::start_datagram(uint64_t timestamp_ns) {
+    auto& datagram = out_[sealed_];
+    datagram.resize(kDatagramHeaderSize);
+    put_u16(&datagram[0], kTunnelMagic);
+    datagram[2] = kTunnelVersion;
+    datagram[3] = 0;
+    put_u32(&datagram[4], next_seq_++);
+    put_u32(&datagram[8], session_);
+    put_u64(&datagram[12], timestamp_ns);
+    base_ts_ = timestamp_ns;
+}
+
+void UdpTunnel::seal_datagram() {
+    if (out_[sealed_].size() > kDatagramHeaderSize) ++sealed_;
+}
+
+bool UdpTunnel::send(uint32_t can_id, std::span<const uint8_t> data, uint64_t timestamp_ns) {
+    if (data.size() > kMaxFrameData) return false;
+
+    std::lock_guard lock(send_mutex_);
+    if (fd_ < 0) return false;
+
+    const size_t need = kFrameHeaderSize + data.size();
+    bool ok = true;
+
+    // Both forwarding threads may send; an out-of-order timestamp or one too
+    // far from the base for a 32-bit offset starts a new datagram.
+    if (sealed_ < out_.size() && out_[sealed_].size() > kDatagramHeaderSize) {
+        auto& current = out_[sealed_];
+        if (current.size() + need > config_.max_datagram || current[3] == kMaxFramesPerDatagram ||
+            timestamp_ns < base_ts_ || timestamp_ns - base_ts_ > std::numeric_limits<uint32_t>::max()) {
+            seal_datagram();
+        }
+    }
+    if (sealed_ == out_.size()) ok = flush_locked();
+    if (out_[sealed_].size() <= kDatagramHeaderSize) start_datagram(timestamp_ns);
+
+    auto& datagram = out_[sealed_];
+    size_t off = datagram.size();
+    datagram.resize(off + need);
+    put_u32(&datagram[off], static_cast<uint32_t>(timestamp_ns - base_ts_));
+    put_u32(&datagram[off + 4], can_id);
+    datagram[off + 8] = static_cast<uint8_t>(data.size());
+    datagram[off + 9] = 0;
+    std::copy(data.begin(), data.end(), datagram.begin() + off + kFrameHeaderSize);
+    ++datagram[3];
+
+    if (pending_frames_++ == 0) {
+        oldest_ = std::chrono::steady_clock::now();
+        flush_cv_.notify_one();
+    }
+    return ok;
+}
+
+bool UdpTunnel::flush() {
+    std::lock_guard lock(send_mutex_);
+    return flush_locked();
+}
+
+bool UdpTunnel::flush_locked() {
+    if (sealed_ < out_.size()) seal_datagram();
+    if (sealed_ == 0) return true;
+
+    const size_t count = sealed_;
+    const size_t frames = pending_frames_;
+    sealed_ = 0;
+    pending_frames_ = 0;
+
+    if (!have_peer_ || fd_ < 0) {
+        unsent_frames_ += frames;
+        for (auto& datagram : out_) datagram.clear();
+        return false;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        tx_iov_[i] = { out_[i].data(), out_[i].size() };
+        tx_msgs_[i] = {};
+        tx_msgs_[i].msg_hdr.msg_iov = &tx_iov_[i];
+        tx_msgs_[i].msg_hdr.msg_iovlen = 1;
+        tx_msgs_[i].msg_hdr.msg_name = &peer_;
+        tx_msgs_[i].msg_hdr.msg_namelen = sizeof(peer_);
+    }
+
+    bool ok = true;
+    size_t done = 0;
+    while (done < count) {
+        int n = sendmmsg(fd_, tx_msgs_.data() + done, count - done, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log(std::string("Tunnel sendmmsg: ") + std::strerror(errno));
+            send_errors_ += count - done;
+            ok = false;
+            break;
+        }
+        for (int i = 0; i < n; ++i) frames_sent_ += out_[done + i][3];
+        datagrams_sent_ += n;
+        done += n;
+    }
+
+    for (auto& datagram : out_) datagram.clear();
+    return ok;
+}
+
+void UdpTunnel::run_flusher() {
+    const auto budget = std::chrono::microseconds(config_.max_latency_us);
+    std::unique_lock lock(send_mutex_);
+    while (!stop_) {
+        if (pending_frames_ == 0) {
+            flush_cv_.wait(lock);
+            continue;
+        }
+        auto deadline = oldest_ + budget;
+        flush_cv_.wait_until(lock, deadline);
+        if (pending_frames_ > 0 && std::chrono::steady_clock::now() >= oldest_ + budget) flush_locked();
+    }
+}
+
+bool UdpTunnel::decode(std::span<const uint8_t> datagram, uint32_t& session, uint32_t& sequence,
+                       std::vector<TunnelFrame>& out) {
+    if (datagram.size() < kDatagramHeaderSize) return false;
+    const uint8_t* p = datagram.data();
+    if (get_u16(p) != kTunnelMagic || p[2] != kTunnelVersion) return false;
+
+    const size_t count = p[3];
+    const uint64_t base = get_u64(p + 12);
+    const size_t before = out.size();
+
+    size_t off = kDatagramHeaderSize;
+    for (size_t i = 0; i < count; ++i) {
+        if (datagram.size() - off < kFrameHeaderSize) break;
+        uint8_t len = p[off + 8];
+        if (len > kMaxFrameData || datagram.size() - off - kFrameHeaderSize < len) break;
+
+        TunnelFrame& frame = out.emplace_back();
+        frame.timestamp_ns = base + get_u32(p + off);
+        frame.can_id = get_u32(p + off + 4);
+        frame.len = len;
+        std::memcpy(frame.data, p + off + kFrameHeaderSize, len);
+        off += kFrameHeaderSize + len;
+    }
+
+    if (out.size() - before != count || off != datagram.size()) {
+        out.resize(before);
+        return false;
+    }
+    sequence = get_u32(p + 4);
+    session = get_u32(p + 8);
+    return true;
+}
+
+void UdpTunnel::track_sequence(uint32_t session, uint32_t sequence) {
+    if (have_seq_ && session == stale_session_ && session != peer_session_) {
+        // Reordered behind the peer's restart; its gap no longer matters.
+        ++late_datagrams_;
+        return;
+    }
+    if (!have_seq_ || session != peer_session_) {
+        if (have_seq_) {
+            log("Tunnel peer restarted (new session)");
+            stale_session_ = peer_session_;
+        }
+        have_seq_ = true;
+        peer_session_ = session;
+        expected_seq_ = sequence + 1;
+        return;
+    }
+
+    int32_t diff = static_cast<int32_t>(sequence - expected_seq_);
+    if (diff >= 0) {
+        lost_datagrams_ += diff;
+        expected_seq_ = sequence + 1;
+    } else if (diff > -kRestartWindow) {
+        // Counted as lost when the gap opened; it was only reordered.
+        ++late_datagrams_;
+        if (lost_datagrams_ > 0) --lost_datagrams_;
+    } else {
+        log("Tunnel peer sequence jumped back; resyncing");
+        expected_seq_ = sequence + 1;
+    }
+}
+
+void UdpTunnel::learn_peer(const struct sockaddr_in& from) {
+    std::lock_guard lock(send_mutex_);
+    if (have_peer_ && peer_.sin_addr.s_addr == from.sin_addr.s_addr && peer_.sin_port == from.sin_port) return;
+    peer_ = from;
+    have_peer_ = true;
+
+    char addr[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &from.sin_addr, addr, sizeof(addr));
+    log("Tunnel peer is " + std::string(addr) + ":" + std::to_string(ntohs(from.sin_port)));
+}
+
+size_t UdpTunnel::receive(std::vector<TunnelFrame>& out, int timeout_ms) {
+    if (fd_ < 0) return 0;
+
+    struct pollfd pfd = { fd_, POLLIN, 0 };
+    if (poll(&pfd, 1, timeout_ms) <= 0) return 0;
+
+    std::lock_guard lock(recv_mutex_);
+    const size_t batch = config_.batch;
+    for (size_t i = 0; i < batch; ++i) {
+        rx_iov_[i] = { rx_buf_.data() + i * config_.max_datagram, config_.max_datagram };
+        rx_msgs_[i] = {};
+        rx_msgs_[i].msg_hdr.msg_iov = &rx_iov_[i];
+        rx_msgs_[i].msg_hdr.msg_iovlen = 1;
+        rx_msgs_[i].msg_hdr.msg_name = &rx_from_[i];
+        rx_msgs_[i].msg_hdr.msg_namelen = sizeof(rx_from_[i]);
+    }
+
+    int n = recvmmsg(fd_, rx_msgs_.data(), batch, MSG_DONTWAIT, nullptr);
+    if (n <= 0) return 0;
+
+    const size_t before = out.size();
+    for (int i = 0; i < n; ++i) {
+        uint32_t session, sequence;
+        std::span<const uint8_t> datagram(static_cast<const uint8_t*>(rx_iov_[i].iov_base), rx_msgs_[i].msg_len);
+        if ((rx_msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) || !decode(datagram, session, sequence, out)) {
+            ++malformed_datagrams_;
+            continue;
+        }
+        ++datagrams_received_;
+        track_sequence(session, sequence);
+        if (config_.peer.empty()) learn_peer(rx_from_[i]);
+    }
+
+    frames_received_ += out.size() - before;
+    return out.size() - before;
+}
+
+TunnelCounters UdpTunnel::counters() const {
+    TunnelCounters c;
+    c.frames_sent = frames_sent_;
+    c.datagrams_sent = datagrams_sent_;
+    c.send_errors = send_errors_;
+    c.unsent_frames = unsent_frames_;
+    c.frames_received = frames_received_;
+    c.datagrams_received = datagrams_received_;
+    c.lost_datagrams = lost_datagrams_;
+    c.late_datagrams = late_datagrams_;
+    c.malformed_datagrams = malformed_datagrams_;
+    return c;
+}
+
+uint16_t UdpTunnel::local_port() const {
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    if (fd_ < 0 || getsockname(fd_, reinterpret_cast<struct sockaddr*>(&addr), &len) < 0) return 0;
+    return ntohs(addr.sin_port);
+}
+
+std::string format_counters(const TunnelCounters& c) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+        << "Tunnel: sent " << c.frames_sent << " frames in " << c.datagrams_sent << " datagrams ("
+        << c.frames_per_datagram() << " frames/datagram), received " << c.frames_received
+        << " frames in " << c.datagrams_received << " datagrams; lost " << c.lost_datagrams
+        << ", late " << c.late_datagrams << ", malformed " << c.malformed_datagrams
+        << ", send errors " << c.send_errors << ", unsent " << c.unsent_frames << " frames";
+    return oss.str();
+}
+
+} // namespace can_tunnel
@@ -0,0 +1,259 @@
+#include "udp_can_tunnel.hpp"
+
+#include <gtest/gtest.h>
+#include <linux/can.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include <string>
+
+using namespace can_tunnel;
+
+namespace {
+
+TunnelConfig loopback_config(uint16_t peer_port = 0) {
+    TunnelConfig config;
+    config.bind = "127.0.0.1:0";
+    if (peer_port) config.peer = "127.0.0.1:" + std::to_string(peer_port);
+    return config;
+}
+
+// Receives until `count` frames arrived or nothing came for 200 ms.
+std::vector<TunnelFrame> receive_frames(UdpTunnel& tunnel, size_t count) {
+    std::vector<TunnelFrame> frames;
+    while (frames.size() < count && tunnel.receive(frames, 200) > 0) {}
+    return frames;
+}
+
+std::vector<uint8_t> datagram(uint32_t sequence, uint8_t count = 0, uint32_t session = 1) {
+    std::vector<uint8_t> d(kDatagramHeaderSize, 0);
+    d[0] = 'C';
+    d[1] = 'T';
+    d[2] = kTunnelVersion;
+    d[3] = count;
+    for (int i = 0; i < 4; ++i) d[4 + i] = sequence >> (8 * i);
+    for (int i = 0; i < 4; ++i) d[8 + i] = session >> (8 * i);
+    return d;
+}
+
+void send_raw(uint16_t port, const std::vector<uint8_t>& bytes) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sendto(fd, bytes.data(), bytes.size(), 0, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    close(fd);
+}
+
+} // namespace
+
+TEST(UdpTunnelTest, DecodeRejectsMalformedDatagrams) {
+    std::vector<TunnelFrame> out;
+    uint32_t session = 0, sequence = 0;
+
+    auto d = datagram(7, 1, 0xC0FFEE);
+    d.insert(d.end(), {0, 0, 0, 0, 0x23, 0x01, 0, 0, 2, 0, 0xDE, 0xAD});
+    ASSERT_TRUE(UdpTunnel::decode(d, session, sequence, out));
+    EXPECT_EQ(sequence, 7u);
+    EXPECT_EQ(session, 0xC0FFEEu);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].can_id, 0x123u);
+    EXPECT_EQ(out[0].len, 2);
+
+    auto truncated = d;
+    truncated.pop_back();
+    EXPECT_FALSE(UdpTunnel::decode(truncated, session, sequence, out));
+    auto trailing = d;
+    trailing.push_back(0);
+    EXPECT_FALSE(UdpTunnel::decode(trailing, session, sequence, out));
+    auto bad_magic = d;
+    bad_magic[0] = 'X';
+    EXPECT_FALSE(UdpTunnel::decode(bad_magic, session, sequence, out));
+    EXPECT_EQ(out.size(), 1u);
+}
+
+TEST(UdpTunnelTest, BatchesFramesOverLocalhost) {
+    UdpTunnel receiver(loopback_config());
+    ASSERT_TRUE(receiver.open());
+    UdpTunnel sender(loopback_config(receiver.local_port()));
+    ASSERT_TRUE(sender.open());
+
+    const size_t kFrames = 5000;
+    std::vector<uint8_t> payload(8);
+    for (uint32_t i = 0; i < kFrames; ++i) {
+        payload[0] = i & 0xFF;
+        uint32_t id = (i % 2) ? (0x18DAF100 + i % 256) | CAN_EFF_FLAG : i % 0x800;
+        ASSERT_TRUE(sender.send(id, payload, 1'000'000'000ull + i * 1000));
+    }
+    ASSERT_TRUE(sender.flush());
+
+    auto frames = receive_frames(receiver, kFrames);
+    ASSERT_EQ(frames.size(), kFrames);
+    for (uint32_t i = 0; i < kFrames; ++i) {
+        uint32_t id = (i % 2) ? (0x18DAF100 + i % 256) | CAN_EFF_FLAG : i % 0x800;
+        ASSERT_EQ(frames[i].can_id, id);
+        ASSERT_EQ(frames[i].timestamp_ns, 1'000'000'000ull + i * 1000);
+        ASSERT_EQ(frames[i].len, 8);
+        ASSERT_EQ(frames[i].data[0], i & 0xFF);
+    }
+
+    TunnelCounters sent = sender.counters();
+    EXPECT_EQ(sent.frames_sent, kFrames);
+    EXPECT_GT(sent.frames_per_datagram(), 70.0);   // 76 classic frames fit in 1400 bytes
+
+    TunnelCounters received = receiver.counters();
+    EXPECT_EQ(received.frames_received, kFrames);
+    EXPECT_EQ(received.datagrams_received, sent.datagrams_sent);
+    EXPECT_EQ(received.lost_datagrams, 0u);
+}
+
+TEST(UdpTunnelTest, LatencyBudgetFlushesPartialDatagram) {
+    UdpTunnel receiver(loopback_config());
+    ASSERT_TRUE(receiver.open());
+    TunnelConfig config = loopback_config(receiver.local_port());
+    config.max_latency_us = 50'000;
+    UdpTunnel sender(config);
+    ASSERT_TRUE(sender.open());
+
+    // Far fewer frames than fill a datagram, and no flush(): only the
+    // flusher thread can send them. No upper bound on how long that takes is
+    // asserted, only that they all arrive, in order.
+    const size_t kFrames = 10;
+    std::vector<uint8_t> payload(1);
+    for (uint32_t i = 0; i < kFrames; ++i) {
+        payload[0] = static_cast<uint8_t>(i);
+        ASSERT_TRUE(sender.send(0x700 + i, payload, UdpTunnel::now_ns()));
+    }
+
+    std::vector<TunnelFrame> frames;
+    auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (frames.size() < kFrames && std::chrono::steady_clock::now() < give_up)
+        receiver.receive(frames, 100);
+
+    ASSERT_EQ(frames.size(), kFrames);
+    for (uint32_t i = 0; i < kFrames; ++i) {
+        EXPECT_EQ(frames[i].can_id, 0x700 + i);
+        EXPECT_EQ(frames[i].data[0], i);
+    }
+    TunnelCounters sent = sender.counters();
+    EXPECT_EQ(sent.frames_sent, kFrames);
+    EXPECT_GE(sent.datagrams_sent, 1u);
+    EXPECT_EQ(sent.unsent_frames, 0u);
+    EXPECT_EQ(receiver.counters().lost_datagrams, 0u);
+}
+
+TEST(UdpTunnelTest, SequenceGapsCountAsLossUntilFilled) {
+    UdpTunnel receiver(loopback_config());
+    ASSERT_TRUE(receiver.open());
+    uint16_t port = receiver.local_port();
+
+    std::vector<TunnelFrame> frames;
+    for (uint32_t seq : {10u, 11u, 14u}) {
+        send_raw(port, datagram(seq));
+        receiver.receive(frames, 200);
+    }
+    EXPECT_EQ(receiver.counters().lost_datagrams, 2u);
+
+    send_raw(port, datagram(12));
+    receiver.receive(frames, 200);
+    TunnelCounters c = receiver.counters();
+    EXPECT_EQ(c.lost_datagrams, 1u);
+    EXPECT_EQ(c.late_datagrams, 1u);
+
+    send_raw(port, {0x00, 0x01, 0x02});
+    receiver.receive(frames, 200);
+    EXPECT_EQ(receiver.counters().malformed_datagrams, 1u);
+    EXPECT_EQ(receiver.counters().datagrams_received, 4u);
+}
+
+TEST(UdpTunnelTest, PeerRestartIsNeitherLossNorReordering) {
+    UdpTunnel receiver(loopback_config());
+    ASSERT_TRUE(receiver.open());
+
+    // One datagram per flush, so sequence numbers advance per frame.
+    std::vector<uint8_t> payload(8);
+    auto send_datagrams = [&](UdpTunnel& sender, uint32_t first, uint32_t count) {
+        for (uint32_t i = first; i < first + count; ++i) {
+            payload[0] = static_cast<uint8_t>(i);
+            ASSERT_TRUE(sender.send(0x100 + i, payload, UdpTunnel::now_ns()));
+            ASSERT_TRUE(sender.flush());
+        }
+    };
+
+    std::vector<TunnelFrame> frames;
+    {
+        UdpTunnel before(loopback_config(receiver.local_port()));
+        ASSERT_TRUE(before.open());
+        send_datagrams(before, 0, 20);
+        auto got = receive_frames(receiver, 20);
+        frames.insert(frames.end(), got.begin(), got.end());
+    }
+
+    // The restarted endpoint counts from sequence 0 again, well behind the
+    // 20 the receiver expects next.
+    UdpTunnel after(loopback_config(receiver.local_port()));
+    ASSERT_TRUE(after.open());
+    send_datagrams(after, 20, 5);
+    auto got = receive_frames(receiver, 5);
+    frames.insert(frames.end(), got.begin(), got.end());
+
+    ASSERT_EQ(frames.size(), 25u);
+    for (uint32_t i = 0; i < frames.size(); ++i) EXPECT_EQ(frames[i].can_id, 0x100 + i);
+    TunnelCounters c = receiver.counters();
+    EXPECT_EQ(c.datagrams_received, 25u);
+    EXPECT_EQ(c.lost_datagrams, 0u);
+    EXPECT_EQ(c.late_datagrams, 0u);
+
+}
+
+TEST(UdpTunnelTest, StragglerFromPreviousSessionIsLate) {
+    UdpTunnel receiver(loopback_config());
+    ASSERT_TRUE(receiver.open());
+    uint16_t port = receiver.local_port();
+
+    std::vector<TunnelFrame> frames;
+    for (uint32_t seq = 0; seq < 5; ++seq) {
+        send_raw(port, datagram(seq, 0, 0xAAAA));
+        receiver.receive(frames, 200);
+    }
+    send_raw(port, datagram(0, 0, 0xBBBB));
+    receiver.receive(frames, 200);
+    // Overtaken by the restart: late, and the receiver stays on the new session.
+    send_raw(port, datagram(5, 0, 0xAAAA));
+    receiver.receive(frames, 200);
+    send_raw(port, datagram(1, 0, 0xBBBB));
+    receiver.receive(frames, 200);
+
+    TunnelCounters c = receiver.counters();
+    EXPECT_EQ(c.datagrams_received, 8u);
+    EXPECT_EQ(c.late_datagrams, 1u);
+    EXPECT_EQ(c.lost_datagrams, 0u);
+}
+
+TEST(UdpTunnelTest, RepliesToLearnedPeer) {
+    UdpTunnel server(loopback_config());
+    ASSERT_TRUE(server.open());
+    UdpTunnel client(loopback_config(server.local_port()));
+    ASSERT_TRUE(client.open());
+
+    std::vector<uint8_t> payload = {0x01, 0x02};
+    std::vector<TunnelFrame> frames;
+
+    // Nobody has talked to the server yet, so it has nowhere to send.
+    server.send(0x100, payload, 1);
+    EXPECT_FALSE(server.flush());
+    EXPECT_EQ(server.counters().unsent_frames, 1u);
+
+    ASSERT_TRUE(client.send(0x200, payload, 1));
+    ASSERT_TRUE(client.flush());
+    ASSERT_EQ(server.receive(frames, 500), 1u);
+
+    frames.clear();
+    ASSERT_TRUE(server.send(0x300, payload, 2));
+    ASSERT_TRUE(server.flush());
+    ASSERT_EQ(client.receive(frames, 500), 1u);
+    EXPECT_EQ(frames[0].can_id, 0x300u);
+}
@@ -0,0 +1,102 @@
+#include "bring_up.hpp"
+
+#include <future>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <sys/ioctl.h>
+#include <net/if.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+BringUpReport bring_up_adapter(can_usb::CanUsbDevice& usb, const BringUpOptions& options) {
+    BringUpReport report;
+    report.device = usb.device();
+    auto start = Clock::now();
+
+    if (!usb.open()) {
+        report.detail = "open failed";
+    } else if (!options.baud_candidates.empty()) {
+        report.verified = usb.detect_baudrate(options.baud_candidates, options.verify_timeout_ms).has_value();
+        report.detail = report.verified ? "baudrate detected" : "no answer at any candidate baudrate";
+    } else if (options.verify_timeout_ms > 0) {
+        report.verified = usb.verify(options.verify_timeout_ms);
+        report.detail = report.verified ? "verified" : "no answer within " +
+                                          std::to_string(options.verify_timeout_ms) + " ms";
+    } else {
+        report.ready = usb.init();
+        report.detail = report.ready ? "settings sent (unverified)" : "settings write failed";
+    }
+
+    if (report.verified) {
+        report.ready = true;
+    } else if (usb.get_fd() != -1 && options.verify_timeout_ms > 0 && !options.require_verified) {
+        // verify() already re-sent the settings; this only confirms the write.
+        report.ready = usb.init();
+        report.unconfirmed = report.ready;
+        report.detail += report.ready ? ", continuing unverified" : ", settings write failed";
+    }
+
+    report.baudrate = usb.baudrate();
+    report.time_to_ready = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+    return report;
+}
+
+BringUpReport bring_up_socket(SocketCanInterface& sock) {
+    BringUpReport report;
+    report.device = sock.interface_name();
+    auto start = Clock::now();
+
+    if (sock.open_device() != SocketCanInterface::Status::Success) {
+        report.detail = "open failed";
+    } else {
+        // Binding succeeds on a link that is down; sends would then fail with ENETDOWN.
+        struct ifreq ifr = {};
+        std::strncpy(ifr.ifr_name, report.device.c_str(), IFNAMSIZ - 1);
+        if (ioctl(sock.get_fd(), SIOCGIFFLAGS, &ifr) < 0) {
+            report.detail = std::string("SIOCGIFFLAGS: ") + std::strerror(errno);
+        } else if (!(ifr.ifr_flags & IFF_UP)) {
+            report.detail = "link is down";
+        } else {
+            report.ready = true;
+            report.detail = "bound";
+        }
+    }
+
+    report.time_to_ready = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+    return report;
+}
+
+} // namespace
+
+std::vector<BringUpReport> bring_up(std::span<can_usb::CanUsbDevice* const> adapters,
+                                    std::span<SocketCanInterface* const> sockets,
+                                    const BringUpOptions& options) {
+    std::vector<std::future<BringUpReport>> tasks;
+    tasks.reserve(adapters.size() + sockets.size());
+    for (auto* usb : adapters)
+        tasks.push_back(std::async(std::launch::async, bring_up_adapter, std::ref(*usb), std::cref(options)));
+    for (auto* sock : sockets)
+        tasks.push_back(std::async(std::launch::async, bring_up_socket, std::ref(*sock)));
+
+    std::vector<BringUpReport> reports;
+    reports.reserve(tasks.size());
+    for (auto& task : tasks) reports.push_back(task.get());
+    return reports;
+}
+
+std::string format_bring_up(const std::vector<BringUpReport>& reports) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1);
+    for (const auto& r : reports) {
+        const char* tag = !r.ready ? "[FAILED] " : r.unconfirmed ? "[WARN] " : "[READY] ";
+        oss << tag << r.device << ": " << r.detail
+            << " in " << r.time_to_ready.count() / 1000.0 << " ms";
+        if (r.baudrate) oss << " (" << r.baudrate << " baud)";
+        oss << "\n";
+    }
+    return oss.str();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "can_usb_interface.hpp"
+#include "socket_can_interface.hpp"
+
+#include <string>
+#include <vector>
+#include <span>
+#include <chrono>
+
+// Serial rates tried by `--baudrate auto`, most likely first.
+inline constexpr int kDefaultBaudCandidates[] = {
+    2000000, 1228800, 921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600
+};
+
+struct BringUpOptions {
+    // How long each adapter gets to echo its verification probe; 0 sends the
+    // settings without waiting for confirmation (the old init() behaviour).
+    int verify_timeout_ms = 250;
+    // Non-empty: ignore the configured baudrate and probe these instead.
+    std::vector<int> baud_candidates;
+    // Some adapters and firmware never echo in loopback-silent mode, so by
+    // default an adapter that does not answer is only warned about and used
+    // with its settings sent unconfirmed. Set this to make it fatal instead.
+    bool require_verified = false;
+};
+
+struct BringUpReport {
+    std::string device;
+    bool ready = false;
+    bool verified = false;      // USB adapters only: the probe was echoed
+    bool unconfirmed = false;   // ready, but only because verification is not required
+    std::chrono::microseconds time_to_ready{0};
+    int baudrate = 0;           // USB adapters only: the verified serial rate
+    std::string detail;
+};
+
+// Opens every adapter and SocketCAN interface concurrently, one task per
+// device, so bring-up takes as long as the slowest device instead of the sum.
+// An adapter is ready once it has echoed a probe (see CanUsbDevice::verify),
+// or, unless BringUpOptions::require_verified, once its settings are sent;
+// a SocketCAN interface once it is bound and the link is up.
+std::vector<BringUpReport> bring_up(std::span<can_usb::CanUsbDevice* const> adapters,
+                                    std::span<SocketCanInterface* const> sockets,
+                                    const BringUpOptions& options);
+
+std::string format_bring_up(const std::vector<BringUpReport>& reports);
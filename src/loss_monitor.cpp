@@ -0,0 +1,59 @@
+#include "loss_monitor.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+LossMonitor::LossMonitor(can_usb::CanUsbDevice& usb, SocketCanInterface& sock,
+                         uint64_t warn_threshold, int sustain_samples, int max_receive_buffer)
+    : _usb(usb), _sock(sock), _warn_threshold(warn_threshold),
+      _sustain_samples(sustain_samples), _max_receive_buffer(max_receive_buffer) {}
+
+const LossSample& LossMonitor::totals() const {
+    return _last;
+}
+
+void LossMonitor::sample() {
+    LossSample now;
+    now.socket_drops = _sock.rx_queue_drops();
+    now.usb_queue_drops = _usb.dropped_frames();
+    now.link = _usb.link_counters();
+
+    if (now.socket_drops > _last.socket_drops) {
+        int current = _sock.receive_buffer();
+        if (current > 0 && current < _max_receive_buffer) {
+            // The kernel doubles whatever is requested to cover its own overhead.
+            int target = std::min(current * 2, _max_receive_buffer);
+            _sock.set_receive_buffer(target / 2);
+            std::cerr << "[WARN] SocketCAN receive queue overflowed ("
+                      << now.socket_drops - _last.socket_drops << " frames); receive buffer "
+                      << current << " -> " << _sock.receive_buffer() << " bytes\n";
+        }
+    }
+
+    uint64_t lost = now.total() - _last.total();
+    if (lost > _warn_threshold) {
+        if (++_lossy_samples % _sustain_samples == 0) {
+            std::cerr << "[WARN] Sustained frame loss: " << lost << " in the last sample\n"
+                      << format() << "\n";
+        }
+    } else {
+        _lossy_samples = 0;
+    }
+
+    _last = now;
+}
+
+std::string LossMonitor::format() const {
+    std::ostringstream oss;
+    oss << "loss: socket_rx_overflow=" << _last.socket_drops
+        << " usb_queue_full=" << _last.usb_queue_drops
+        << " serial_checksum=" << _last.link.checksum_errors
+        << " serial_stop_byte=" << _last.link.stop_byte_errors
+        << " serial_resync_bytes=" << _last.link.resync_bytes
+        << " tty_overrun=" << _last.link.tty_overruns
+        << " tty_buf_overrun=" << _last.link.tty_buffer_overruns
+        << " tty_framing=" << _last.link.tty_framing_errors
+        << " tty_parity=" << _last.link.tty_parity_errors;
+    return oss.str();
+}
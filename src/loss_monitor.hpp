@@ -0,0 +1,42 @@
+#pragma once
+
+#include "can_usb_interface.hpp"
+#include "socket_can_interface.hpp"
+
+#include <string>
+#include <cstdint>
+
+// Every point where the bridge can lose a frame, as cumulative counts.
+struct LossSample {
+    uint64_t socket_drops = 0;        // SocketCAN receive queue overflow (SO_RXQ_OVFL)
+    uint64_t usb_queue_drops = 0;     // frames rejected while the adapter was unplugged
+    can_usb::LinkCounters link;       // serial parser discards and tty error counters
+
+    uint64_t total() const {
+        return socket_drops + usb_queue_drops + link.discarded() + link.tty_errors();
+    }
+};
+
+// Polled from the bridge's housekeeping loop. Grows the CAN socket's receive
+// buffer when the kernel starts dropping frames and warns once loss has stayed
+// above the threshold for several consecutive samples.
+class LossMonitor {
+public:
+    LossMonitor(can_usb::CanUsbDevice& usb, SocketCanInterface& sock,
+                uint64_t warn_threshold, int sustain_samples = 3,
+                int max_receive_buffer = 8 * 1024 * 1024);
+
+    void sample();
+    const LossSample& totals() const;
+    std::string format() const;
+
+private:
+    can_usb::CanUsbDevice& _usb;
+    SocketCanInterface& _sock;
+    uint64_t _warn_threshold;
+    int _sustain_samples;
+    int _max_receive_buffer;
+
+    LossSample _last;
+    int _lossy_samples = 0;
+};
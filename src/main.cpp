@@ -1,5 +1,13 @@
 #include "can_usb_interface.hpp"
 #include "socket_can_interface.hpp"
+#include "shm_frame_ring.hpp"
+#include "udp_can_tunnel.hpp"
+#include "can_bus_stats.hpp"
+#include "can_id_rules.hpp"
+#include "can_fd_packing.hpp"
+#include "loss_monitor.hpp"
+#include "bring_up.hpp"
+#include "can_trace.hpp"
 
 #include <iostream>
 #include <thread>
@@ -8,25 +16,32 @@
 #include <csignal>
 #include <cstring>
 #include <unordered_map>
+#include <optional>
 
 using namespace std::chrono_literals;
 std::atomic<bool> running = true;
+std::atomic<bool> stats_requested = false;
 
 void signal_handler(int) {
     running = false;
 }
 
+void stats_signal_handler(int) {
+    stats_requested = true;
+}
+
 std::unordered_map<std::string, std::string> parse_args(int argc, char* argv[]) {
     std::unordered_map<std::string, std::string> args;
     for (int i = 1; i < argc; ++i) {
-        if (std::strncmp(argv[i], "--", 2) == 0 && i + 1 < argc) {
+        // A following "--option" is never taken as a value, so flags can precede options.
+        if (std::strncmp(argv[i], "--", 2) == 0 && i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0) {
             args[argv[i]] = argv[i + 1];
             ++i;
-        } else if (std::strncmp(argv[i], "--debug", 7) == 0) {
+        } else if (std::strcmp(argv[i], "--debug") == 0) {
             args["--debug"] = "true";
-        } else if (std::strncmp(argv[i], "--fd", 4) == 0) {
+        } else if (std::strcmp(argv[i], "--fd") == 0) {
             args["--fd"] = "true";
-        } else if (std::strncmp(argv[i], "--help", 6) == 0) {
+        } else if (std::strcmp(argv[i], "--help") == 0) {
             args["--help"] = "true";
         }
     }
@@ -38,10 +53,26 @@ void print_help() {
               << "Options:\n"
               << "  --usb <device>       USB device path (default: /dev/ttyUSB0)\n"
               << "  --iface <name>       SocketCAN interface (default: vcan0)\n"
-              << "  --baudrate <value>   Serial baudrate (default: 2000000)\n"
+              << "  --baudrate <value>   Serial baudrate, or 'auto' to detect it (default: 2000000)\n"
               << "  --speed <enum>       CAN speed enum (default: 1)\n"
               << "  --debug              Enable debug logging\n"
               << "  --fd                 Use CAN FD\n"
+              << "  --verify-timeout <ms> Wait this long for the adapter to confirm its settings (default: 250, 0 = don't wait)\n"
+              << "  --verify <mode>      warn: start anyway if the adapter does not confirm; require: refuse to start (default: warn)\n"
+              << "  --fd-pack <filter>   Split CAN FD payloads across classic frames on the adapter link (requires --fd)\n"
+              << "                       for IDs matching <filter>: all, <id> or <value>/<mask>\n"
+              << "  --usb-queue <n>      Frames held while the USB adapter is unplugged (default: 1024)\n"
+              << "  --rules <file>       ID remapping / payload rewrite rules\n"
+              << "  --tunnel <host:port> Also forward frames to/from a remote endpoint over UDP\n"
+              << "  --tunnel-bind <[addr:]port> Local UDP endpoint for the tunnel (default: 0.0.0.0:5800)\n"
+              << "  --tunnel-latency-us <us> Max time a frame waits for its datagram to fill (default: 1000)\n"
+              << "  --wait <mode>        How idle forwarding threads wait: block, spin or adaptive (default: adaptive)\n"
+              << "  --spin-us <us>       Adaptive: busy-poll this long after each frame before blocking (default: 200)\n"
+              << "  --busy-poll <us>     Set SO_BUSY_POLL on the CAN socket (default: 0 = off)\n"
+              << "  --shm <name>         Publish all frames to /dev/shm/<name> for local readers\n"
+              << "  --shm-slots <n>      Frame ring capacity (default: 4096)\n"
+              << "  --stats-interval <s> Print traffic statistics every <s> seconds (default: 0 = on SIGUSR1 only)\n"
+              << "  --loss-warn <n>      Warn when more than <n> frames/s are lost for 3 s (default: 0)\n"
               << "  --help               Show this help\n";
 }
 
@@ -54,57 +85,262 @@ int main(int argc, char** argv) {
 
     std::string usb_dev = args.contains("--usb") ? args["--usb"] : "/dev/ttyUSB0";
     std::string iface = args.contains("--iface") ? args["--iface"] : "vcan0";
-    int baudrate = args.contains("--baudrate") ? std::stoi(args["--baudrate"]) : 2000000;
+    bool detect_baudrate = args.contains("--baudrate") && args["--baudrate"] == "auto";
+    int baudrate = args.contains("--baudrate") && !detect_baudrate ? std::stoi(args["--baudrate"]) : 2000000;
     int speed_enum = args.contains("--speed") ? std::stoi(args["--speed"]) : 1;
     bool debug = args.contains("--debug");
     bool use_fd = args.contains("--fd");
+    int verify_timeout = args.contains("--verify-timeout") ? std::stoi(args["--verify-timeout"]) : 250;
+    std::string verify_mode = args.contains("--verify") ? args["--verify"] : "warn";
+    std::string fd_pack = args.contains("--fd-pack") ? args["--fd-pack"] : "";
+    int usb_queue = args.contains("--usb-queue") ? std::stoi(args["--usb-queue"]) : 1024;
+    std::string rules_path = args.contains("--rules") ? args["--rules"] : "";
+    std::string tunnel_peer = args.contains("--tunnel") ? args["--tunnel"] : "";
+    std::string tunnel_bind = args.contains("--tunnel-bind") ? args["--tunnel-bind"] : "";
+    int tunnel_latency = args.contains("--tunnel-latency-us") ? std::stoi(args["--tunnel-latency-us"]) : 1000;
+    std::string wait_mode = args.contains("--wait") ? args["--wait"] : "adaptive";
+    int spin_us = args.contains("--spin-us") ? std::stoi(args["--spin-us"]) : 200;
+    int busy_poll = args.contains("--busy-poll") ? std::stoi(args["--busy-poll"]) : 0;
+    std::string shm_name = args.contains("--shm") ? args["--shm"] : "";
+    int shm_slots = args.contains("--shm-slots") ? std::stoi(args["--shm-slots"]) : 4096;
+
+    int stats_interval = args.contains("--stats-interval") ? std::stoi(args["--stats-interval"]) : 0;
+
+    int loss_warn = args.contains("--loss-warn") ? std::stoi(args["--loss-warn"]) : 0;
 
     auto logger = [](const std::string& msg) { std::cerr << "[LOG] " << msg << "\n"; };
 
+    can_rules::RuleSet rules;
+    if (!rules_path.empty()) {
+        std::string error;
+        if (!rules.load_file(rules_path, &error)) {
+            std::cerr << "Failed to load rules from " << rules_path << ": " << error << std::endl;
+            return 1;
+        }
+        if (debug) logger("Loaded " + std::to_string(rules.size()) + " rules from " + rules_path);
+    }
+
+    // Only the forwarding thread of each direction touches its half.
+    std::optional<can_fd_pack::PackingFilter> pack_filter;
+    can_fd_pack::Packer packer;
+    can_fd_pack::Reassembler reassembler;
+    if (!fd_pack.empty()) {
+        // Packing reassembles FD payloads; a CAN 2.0 socket could not carry them.
+        if (!use_fd) {
+            std::cerr << "--fd-pack requires --fd" << std::endl;
+            return 1;
+        }
+        pack_filter = can_fd_pack::parse_filter(fd_pack);
+        if (!pack_filter) {
+            std::cerr << "Invalid --fd-pack filter: " << fd_pack << std::endl;
+            return 1;
+        }
+    }
+
+    WaitMode wait;
+    if (!WaitStrategy::parse_mode(wait_mode.c_str(), wait)) {
+        std::cerr << "Invalid --wait mode: " << wait_mode << std::endl;
+        return 1;
+    }
+    const auto spin_window = std::chrono::microseconds(spin_us);
+
     can_usb::CanUsbDevice usb(usb_dev, baudrate, static_cast<can_usb::Speed>(speed_enum), debug, logger);
+    usb.set_queue_limit(usb_queue);
     SocketCanInterface sock(iface, use_fd ? SocketCanInterface::Mode::CAN_FD : SocketCanInterface::Mode::CAN_2_0, debug, logger);
 
-    if (!usb.open() || !usb.init()) {
-        std::cerr << "Failed to open or initialize USB CAN device." << std::endl;
+    BringUpOptions bring_up_options;
+    bring_up_options.verify_timeout_ms = verify_timeout;
+    if (verify_mode != "warn" && verify_mode != "require") {
+        std::cerr << "Invalid --verify mode: " << verify_mode << std::endl;
         return 1;
     }
+    bring_up_options.require_verified = verify_mode == "require";
+    if (detect_baudrate) {
+        bring_up_options.baud_candidates.assign(std::begin(kDefaultBaudCandidates), std::end(kDefaultBaudCandidates));
+        if (bring_up_options.verify_timeout_ms <= 0) bring_up_options.verify_timeout_ms = 250;
+    }
 
-    if (sock.open_device() != SocketCanInterface::Status::Success) {
-        std::cerr << "Failed to open SocketCAN interface." << std::endl;
-        return 1;
+    can_usb::CanUsbDevice* adapters[] = {&usb};
+    SocketCanInterface* sockets[] = {&sock};
+    auto reports = bring_up(adapters, sockets, bring_up_options);
+    std::cerr << format_bring_up(reports);
+    for (const auto& report : reports) {
+        if (!report.ready) {
+            std::cerr << "Failed to bring up " << report.device << "." << std::endl;
+            return 1;
+        }
+    }
+    baudrate = usb.baudrate();
+
+    // Each forwarding thread owns the strategy it waits with. The adapter is a
+    // tty, so busy polling there is ours alone; the CAN socket can also ask
+    // the kernel to spin on its queue.
+    WaitStrategy usb_wait(wait, spin_window);
+    WaitStrategy host_wait(wait, spin_window);
+    sock.set_wait_strategy(wait, spin_window);
+    if (busy_poll > 0 && !sock.set_busy_poll(busy_poll)) {
+        std::cerr << "SO_BUSY_POLL not available; continuing without it." << std::endl;
+    }
+
+    std::optional<shm_ring::FrameRingWriter> ring;
+    if (!shm_name.empty()) {
+        ring.emplace(shm_name, shm_slots, debug, logger);
+        if (!ring->open()) {
+            std::cerr << "Failed to create shared-memory frame ring." << std::endl;
+            return 1;
+        }
     }
 
+    // The tunnel sits next to the SocketCAN side: frames from the adapter go
+    // to both, frames from either go to the adapter.
+    std::optional<can_tunnel::UdpTunnel> tunnel;
+    if (!tunnel_peer.empty() || !tunnel_bind.empty()) {
+        can_tunnel::TunnelConfig config;
+        config.peer = tunnel_peer;
+        if (!tunnel_bind.empty()) config.bind = tunnel_bind;
+        config.max_latency_us = tunnel_latency;
+        tunnel.emplace(config, debug, logger);
+        if (!tunnel->open()) {
+            std::cerr << "Failed to open UDP tunnel." << std::endl;
+            return 1;
+        }
+    }
+
+    // Both directions share the adapter's bus and serial link; they are kept
+    // apart so each forwarding thread records into its own table.
+    can_stats::BusStatistics usb_rx_stats, usb_tx_stats;
+    const uint32_t bus_bitrate = can_usb::speed_to_bitrate(static_cast<can_usb::Speed>(speed_enum));
+
+    LossMonitor loss(usb, sock, loss_warn);
+
     signal(SIGINT, signal_handler);
+    signal(SIGUSR1, stats_signal_handler);
 
     std::thread usb_to_sock([&]() {
         while (running) {
             auto frame = usb.recv_frame();
-            if (frame) {
-                const auto& f = *frame;
-                if (f.size() >= 5) {
-                    uint32_t id = f[2] | (f[3] << 8);
-                    std::span<const uint8_t> data(f.data() + 4, f.size() - 5);
-                    sock.send_frame(id, data);
-                }
+            if (!frame) {
+                usb_wait.wait_readable({ usb.get_fd() }, 100);
+                continue;
             }
+            // Frames already buffered are read without waiting; keep the spin window open behind them.
+            usb_wait.note_activity();
+
+            // Status and settings replies carry no CAN frame.
+            auto view = can_usb::CanUsbDevice::decode_data_frame(*frame);
+            if (!view) continue;
+
+            uint32_t id = view->can_id;
+            uint64_t now = can_stats::BusStatistics::now_ns();
+            CAN_TRACE(forward_begin, static_cast<int>(can_trace::Direction::UsbToHost), id, view->data.size(), now);
+            usb_rx_stats.record(id, view->data, now, frame->size());
+
+            std::span<uint8_t> data(frame->data() + (view->data.data() - frame->data()), view->data.size());
+            if (pack_filter && pack_filter->matches(id)) {
+                auto whole = reassembler.push(id, data, now);
+                if (!whole) continue;
+                data = *whole;
+            }
+            if (ring) ring->publish(shm_ring::Direction::UsbToHost, id, data, now);
+
+            if (rules.apply(can_rules::Direction::UsbToHost, id, data) == can_rules::Verdict::Drop) continue;
+            sock.send_frame(id, data);
+            if (tunnel) tunnel->send(id, data, now);
+            CAN_TRACE(forward_end, static_cast<int>(can_trace::Direction::UsbToHost), id, data.size(), can_trace::now_ns());
         }
     });
 
     std::thread sock_to_usb([&]() {
+        std::array<can_fd_pack::Fragment, can_fd_pack::kMaxFragments> fragments;
+        auto forward = [&](uint32_t id, std::span<uint8_t> payload) {
+            CAN_TRACE(forward_begin, static_cast<int>(can_trace::Direction::HostToUsb), id, payload.size(), can_trace::now_ns());
+            if (rules.apply(can_rules::Direction::HostToUsb, id, payload) == can_rules::Verdict::Drop) return;
+
+            uint64_t now = can_stats::BusStatistics::now_ns();
+            auto type = (id & CAN_EFF_FLAG) ? can_usb::FrameType::Extended : can_usb::FrameType::Standard;
+            if (pack_filter && pack_filter->matches(id)) {
+                size_t count = packer.pack(id, payload, fragments);
+                for (size_t i = 0; i < count; ++i) {
+                    usb.send_can_frame(id, fragments[i].payload());
+                    usb_tx_stats.record(id, fragments[i].payload(), now,
+                                        can_usb::CanUsbDevice::wire_size(type, fragments[i].len));
+                }
+            } else {
+                usb.send_can_frame(id, payload);
+                usb_tx_stats.record(id, payload, now, can_usb::CanUsbDevice::wire_size(type, payload.size()));
+            }
+            if (ring) ring->publish(shm_ring::Direction::HostToUsb, id, payload, now);
+            CAN_TRACE(forward_end, static_cast<int>(can_trace::Direction::HostToUsb), id, payload.size(), can_trace::now_ns());
+        };
+
+        // Tunnel frames are drained on this thread too, so usb_tx_stats keeps a single writer.
+        std::vector<can_tunnel::TunnelFrame> tunnel_frames;
+        // Without a tunnel the socket waits on its own; with one, both are
+        // checked and the thread only waits once neither had anything.
         while (running) {
-            auto frame = sock.recv_frame();
-            if (frame) {
-                std::vector<uint8_t> payload = frame->second;
-                usb.send_data(can_usb::FrameType::Standard, frame->first, payload);
+            bool idle = true;
+            if (auto frame = sock.recv_frame(tunnel ? 0 : 100)) {
+                auto& [id, payload] = *frame;
+                forward(id, payload);
+                idle = false;
+            }
+            if (tunnel) {
+                tunnel_frames.clear();
+                if (tunnel->receive(tunnel_frames, 0) > 0) idle = false;
+                for (auto& frame : tunnel_frames) forward(frame.can_id, {frame.data, frame.len});
+                if (idle) host_wait.wait_readable({ sock.get_fd(), tunnel->get_fd() }, 100);
+                else host_wait.note_activity();
             }
         }
     });
 
+    auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(stats_interval);
+    auto next_loss_sample = std::chrono::steady_clock::now() + 1s;
+    while (running) {
+        std::this_thread::sleep_for(100ms);
+        if (std::chrono::steady_clock::now() >= next_loss_sample) {
+            loss.sample();
+            next_loss_sample += 1s;
+        }
+        bool periodic = stats_interval > 0 && std::chrono::steady_clock::now() >= next_report;
+        if (stats_requested.exchange(false) || periodic) {
+            uint64_t now = can_stats::BusStatistics::now_ns();
+            auto rx = usb_rx_stats.take_window(now);
+            auto tx = usb_tx_stats.take_window(now);
+            auto bus = rx;
+            bus += tx;
+            // The UART is full duplex, so each direction is measured against the full baudrate.
+            std::cerr << can_stats::format_report("USB -> host", usb_rx_stats, rx, bus_bitrate, baudrate)
+                      << can_stats::format_report("host -> USB", usb_tx_stats, tx, bus_bitrate, baudrate)
+                      << "CAN bus load (both directions): " << bus.bus_load(bus_bitrate) << "%\n"
+                      << loss.format() << "\n";
+            auto host = sock.wait_stats();
+            host += host_wait.stats();
+            std::cerr << format_wait_stats("USB -> host", usb_wait.stats()) << "\n"
+                      << format_wait_stats("host -> USB", host) << "\n";
+            if (tunnel) std::cerr << can_tunnel::format_counters(tunnel->counters()) << "\n";
+            if (pack_filter) {
+                auto tx = packer.counters();
+                auto rx = reassembler.counters();
+                std::cerr << "FD packing: packed " << tx.payloads_packed << " payloads into " << tx.fragments_sent
+                          << " frames, reassembled " << rx.payloads_reassembled << " from " << rx.fragments_received
+                          << "; sequence errors " << rx.sequence_errors << ", timeouts " << rx.timeouts
+                          << ", evictions " << rx.evictions << ", malformed " << rx.malformed << "\n";
+            }
+            next_report = std::chrono::steady_clock::now() + std::chrono::seconds(stats_interval);
+        }
+    }
+
     usb_to_sock.join();
     sock_to_usb.join();
 
     usb.close();
     sock.close_device();
+    if (tunnel) tunnel->close();
+    if (ring) {
+        ring->close();
+        ring->unlink();
+    }
 
     return 0;
 }